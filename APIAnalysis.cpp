@@ -5,6 +5,7 @@
 #include "clang/Tooling/ArgumentsAdjusters.h"
 #include <clang/Frontend/CompilerInstance.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/VirtualFileSystem.h>
 
 #include "include/cxxopts.hpp"
 #include "omp.h"
@@ -18,7 +19,17 @@
 #include "header/ObjectAnalyser.h"
 #include "ConsoleOutputHandler.cpp"
 #include "JSONOutputHandler.cpp"
+#include "header/ExtractionState.h"
+#include "ExtractionState.cpp"
+#include "ExtractionCache.cpp"
+#include "Snapshot.cpp"
 #include "filesystem"
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <unordered_map>
+#include <set>
+#include <string_view>
 
 using namespace llvm;
 using namespace clang;
@@ -27,8 +38,9 @@ using namespace clang;
 using namespace helper;
 using namespace functionanalysis;
 using namespace variableanalysis;
+using namespace extraction;
 
-int clockingThing=0;
+std::atomic<int> clockingThing{0};
 
 template<typename T, class... Args>
 std::unique_ptr<clang::tooling::FrontendActionFactory> argumentParsingFrontendActionFactory(Args... args){
@@ -50,55 +62,100 @@ std::unique_ptr<clang::tooling::FrontendActionFactory> argumentParsingFrontendAc
     return std::unique_ptr<FrontendActionFactory>(new SimpleFrontendActionFactory(args...));
 }
 
-int findFunctionInstance(std::vector<FunctionInstance>* program, const string& filePos){
-    for(int i = 0; i < program->size(); i++){
-        if(program->at(i).filePosition == filePos){
-            return i;
-        }
+// the tool does not change the working directory of the process (to allow parallel extraction), so relative filenames are resolved against the directory of the compile command
+string getAbsoluteFilename(SourceLocation location, clang::ASTContext *Context){
+    SourceManager &sourceManager = Context->getSourceManager();
+    SmallString<256> filename(sourceManager.getFilename(location));
+    if(!filename.empty()){
+        sourceManager.getFileManager().makeAbsolutePath(filename);
     }
-    return -1;
+    return filename.str().str();
 }
 
-int findVariableInstance(std::vector<VariableInstance>* program, const string& filePos){
-    for(int i = 0; i < program->size(); i++){
-        if(program->at(i).filePosition == filePos){
-            return i;
-        }
+// all files that were read for the translation unit (absolute paths)
+void collectIncludedFiles(SourceManager &sourceManager, std::vector<std::string>* includedFiles){
+    for(auto it = sourceManager.fileinfo_begin(); it != sourceManager.fileinfo_end(); ++it){
+        SmallString<256> filename(it->first->getName());
+        sourceManager.getFileManager().makeAbsolutePath(filename);
+        includedFiles->push_back(filename.str().str());
     }
-    return -1;
 }
 
-int findObjectInstance(std::vector<ObjectInstance>* program, const string& filePos){
-    for(int i = 0; i < program->size(); i++){
-        if(program->at(i).filePosition == filePos){
-            return i;
-        }
+/*
+ * Finds the body of a function whose body was skipped by the parser (header-only mode), the AST only knows that there was a body but not where it is
+ * The source is read from the name of the function, the body is the first brace after the parameters that is not a brace initializer of a constructor
+ * Returns an invalid range if the body could not be found (e.g. functions created by macros)
+ */
+SourceRange getSkippedBodyRange(FunctionDecl* functionDecl, clang::ASTContext *Context){
+    SourceManager &sourceManager = Context->getSourceManager();
+    if(functionDecl->getLocation().isMacroID() || functionDecl->getEndLoc().isMacroID()){
+        return SourceRange();
     }
-    return -1;
-}
-
-string getFunctionDeclFilename(FunctionDecl* functionDecl, clang::ASTContext *Context, const string& dir){
-    FullSourceLoc FullLocation = Context->getFullLoc(functionDecl->getBeginLoc());
-    auto filename = std::filesystem::relative(std::filesystem::path(FullLocation.getManager().getFilename(functionDecl->getBeginLoc()).str()), dir);
-    return filename.string();
-}
-
-string getVarDeclFilename(VarDecl* varDecl, clang::ASTContext *Context, const string& dir){
-    FullSourceLoc FullLocation = Context->getFullLoc(varDecl->getBeginLoc());
-    auto filename = std::filesystem::relative(std::filesystem::path(FullLocation.getManager().getFilename(varDecl->getBeginLoc()).str()), dir);
-    return filename.string();
-}
+    auto [fileID, offset] = sourceManager.getDecomposedLoc(functionDecl->getLocation());
+    bool invalid = false;
+    StringRef buffer = sourceManager.getBufferData(fileID, &invalid);
+    if(invalid){
+        return SourceRange();
+    }
+    Lexer lexer(sourceManager.getLocForStartOfFile(fileID), Context->getLangOpts(), buffer.begin(), buffer.begin() + offset, buffer.end());
+
+    // parentheses and brackets (parameters, attributes, noexcept, ...) can contain braces that are not the body
+    int parenDepth = 0;
+    // braces of the member initializers (a{1}) and of the body
+    int braceDepth = 0;
+    bool inInitializers = false;
+    SourceLocation bodyBegin;
+    tok::TokenKind previous = tok::unknown;
+    Token token;
+    while(true){
+        lexer.LexFromRawLexer(token);
+        if(token.is(tok::eof)){
+            return SourceRange();
+        }
+        tok::TokenKind kind = token.getKind();
+        if(bodyBegin.isValid()){
+            if(kind == tok::l_brace){
+                braceDepth++;
+            }else if(kind == tok::r_brace && --braceDepth == 0){
+                return SourceRange(bodyBegin, token.getLocation());
+            }
+            continue;
+        }
 
-string getVarDeclFilename(FieldDecl* varDecl, clang::ASTContext *Context, const string& dir){
-    FullSourceLoc FullLocation = Context->getFullLoc(varDecl->getBeginLoc());
-    auto filename = std::filesystem::relative(std::filesystem::path(FullLocation.getManager().getFilename(varDecl->getBeginLoc()).str()), dir);
-    return filename.string();
+        if(kind == tok::l_paren || kind == tok::l_square){
+            parenDepth++;
+        }else if(kind == tok::r_paren || kind == tok::r_square){
+            parenDepth--;
+        }else if(parenDepth == 0){
+            if(kind == tok::colon && braceDepth == 0){
+                inInitializers = true;
+            }else if(kind == tok::l_brace){
+                // in the initializers the body follows directly after an initializer, everything else is the brace of an initializer
+                if(braceDepth == 0 && (!inInitializers || previous == tok::r_paren || previous == tok::r_brace)){
+                    bodyBegin = token.getLocation();
+                }
+                braceDepth++;
+            }else if(kind == tok::r_brace){
+                braceDepth--;
+            }else if(kind == tok::semi && braceDepth == 0){
+                // = default, = delete, ...
+                return SourceRange();
+            }
+        }
+        previous = kind;
+    }
 }
 
-string getRecordDeclFilename(RecordDecl* recordDecl, clang::ASTContext *Context, const string& dir){
-    FullSourceLoc FullLocation = Context->getFullLoc(recordDecl->getBeginLoc());
-    auto filename = std::filesystem::relative(std::filesystem::path(FullLocation.getManager().getFilename(recordDecl->getBeginLoc()).str()), dir);
-    return filename.string();
+/*
+ * Splits the bodies into the ids of their tokens for the token based comparison of bodies (comments and the formatting are dropped by the lexer)
+ * Runs after the extraction, so the bodies from the cache and from snapshots are handled the same way
+ */
+void tokenizeBodies(std::vector<FunctionInstance>* program, matcher::TokenTable* tokenTable, int jobs){
+    #pragma omp parallel for schedule(dynamic) num_threads(std::max(1, jobs))
+    for(int i = 0; i < (int) program->size(); i++){
+        FunctionInstance& function = program->at(i);
+        function.bodyTokens = tokenTable->getIds(matcher::tokenizeBody(function.body));
+    }
 }
 
 vector<pair<string, pair<string, string>>> getFunctionParams(FunctionDecl* functionDecl, clang::ASTContext *Context){
@@ -139,57 +196,83 @@ vector<pair<string, pair<string, string>>> getFunctionParams(FunctionDecl* funct
     return params;
 }
 
-string getLocation(FunctionDecl* functionDecl, const string& dir, clang::ASTContext* context){
-    SourceManager &sourceManager = context->getSourceManager();
-    SourceRange sourceRange = functionDecl->getSourceRange();
-    return getFunctionDeclFilename(functionDecl, context, dir) + ":" + to_string(sourceManager.getPresumedLineNumber(sourceRange.getBegin())) + ":" + to_string(sourceManager.getPresumedColumnNumber(sourceRange.getBegin()));
-}
-
-string getLocation(VarDecl* varDecl, const string& dir, clang::ASTContext* context){
-    SourceManager &sourceManager = context->getSourceManager();
-    SourceRange sourceRange = varDecl->getSourceRange();
-    return getVarDeclFilename(varDecl, context, dir) + ":" + to_string(sourceManager.getPresumedLineNumber(sourceRange.getBegin())) + ":" + to_string(sourceManager.getPresumedColumnNumber(sourceRange.getBegin()));
-}
-
-string getLocation(FieldDecl* varDecl, const string& dir, clang::ASTContext* context){
-    SourceManager &sourceManager = context->getSourceManager();
-    SourceRange sourceRange = varDecl->getSourceRange();
-    return getVarDeclFilename(varDecl, context, dir) + ":" + to_string(sourceManager.getPresumedLineNumber(sourceRange.getBegin())) + ":" + to_string(sourceManager.getPresumedColumnNumber(sourceRange.getBegin()));
-}
-
-string getLocation(RecordDecl* varDecl, const string& dir, clang::ASTContext* context){
-    SourceManager &sourceManager = context->getSourceManager();
-    SourceRange sourceRange = varDecl->getSourceRange();
-    return getRecordDeclFilename(varDecl, context, dir) + ":" + to_string(sourceManager.getPresumedLineNumber(sourceRange.getBegin())) + ":" + to_string(sourceManager.getPresumedColumnNumber(sourceRange.getBegin()));
-}
-
 class APIAnalysisVisitor : public clang::RecursiveASTVisitor<APIAnalysisVisitor> {
-    std::vector<FunctionInstance>* program;
+    ExtractionSink* sink;
     std::string dir;
-    std::vector<variableanalysis::VariableInstance>* variables;
-    std::vector<objectanalysis::ObjectInstance>* objects;
-    std::vector<std::string> files;
-    std::map<std::string, FunctionInstance>* mapOfDeclarations;
-    std::map<std::string, VariableInstance>* variableDefinitions;
+    // canonical paths of the project files (shared by all translation units of a version)
+    const std::unordered_set<std::string>* projectFiles;
+    // ids of the relative filenames (shared by all translation units of a version)
+    FileTable* fileTable;
+    // canonical paths of the project headers that are extracted by an earlier translation unit (can be null)
+    const std::unordered_set<std::string>* skippedFiles;
+
+    struct FileInfo {
+        bool isProjectFile;
+        bool isSkipped;
+        // relative to the directory of the project (empty for locations without a file)
+        std::string filename;
+        int id;
+    };
+    // most declarations of a translation unit come from (system) headers and a file usually contains many declarations, so every file is only resolved once
+    llvm::DenseMap<FileID, FileInfo> fileCache;
 public:
-    explicit APIAnalysisVisitor(clang::ASTContext *Context, std::vector<FunctionInstance>* program, std::string directory, std::vector<variableanalysis::VariableInstance>* variables, std::vector<objectanalysis::ObjectInstance>* objects, std::vector<std::string> files, std::map<std::string, FunctionInstance>* mapOfDeclarations, std::map<std::string, VariableInstance>* variableDefinitions) : Context(Context){
-        this->program = program;
+    explicit APIAnalysisVisitor(clang::ASTContext *Context, ExtractionSink* sink, std::string directory, const std::unordered_set<std::string>* projectFiles, FileTable* fileTable, const std::unordered_set<std::string>* skippedFiles) : Context(Context){
+        this->sink = sink;
         this->dir = directory;
-        this->variables = variables;
-        this->objects = objects;
-        this->files = files;
-        this->mapOfDeclarations = mapOfDeclarations;
-        this->variableDefinitions = variableDefinitions;
+        this->projectFiles = projectFiles;
+        this->fileTable = fileTable;
+        this->skippedFiles = skippedFiles;
+    }
+
+    // locations inside of macro expansions have no file, so they get an empty filename and are never part of the project
+    const FileInfo& getFileInfo(SourceLocation location){
+        SourceManager &sourceManager = Context->getSourceManager();
+        FileID fileID = sourceManager.getFileID(location);
+        auto cached = fileCache.find(fileID);
+        if(cached != fileCache.end()){
+            return cached->second;
+        }
+
+        FileInfo fileInfo;
+        fileInfo.isProjectFile = false;
+        fileInfo.isSkipped = false;
+        if(sourceManager.getFileEntryForID(fileID)){
+            auto absoluteFilename = std::filesystem::path(getAbsoluteFilename(location, Context));
+            auto canonicalFilename = std::filesystem::weakly_canonical(absoluteFilename).string();
+            fileInfo.isProjectFile = projectFiles->count(canonicalFilename) != 0;
+            fileInfo.isSkipped = fileInfo.isProjectFile && skippedFiles != nullptr && skippedFiles->count(canonicalFilename) != 0;
+            fileInfo.filename = std::filesystem::relative(absoluteFilename, dir).string();
+        }
+        fileInfo.id = fileTable->getId(fileInfo.filename);
+        return fileCache.insert(std::make_pair(fileID, std::move(fileInfo))).first->second;
+    }
+
+    // everything in a skipped file was already found by an earlier translation unit
+    bool isInProjectFile(SourceLocation location){
+        const FileInfo& fileInfo = getFileInfo(location);
+        return fileInfo.isProjectFile && !fileInfo.isSkipped;
+    }
+
+    FilePosition getFilePosition(SourceLocation location){
+        SourceManager &sourceManager = Context->getSourceManager();
+        FilePosition filePosition;
+        filePosition.file = getFileInfo(location).id;
+        filePosition.line = sourceManager.getPresumedLineNumber(location);
+        filePosition.column = sourceManager.getPresumedColumnNumber(location);
+        return filePosition;
     }
 
     FunctionInstance createFunctionInstance(FunctionDecl* functionDecl){
 
-        clockingThing++;
-        if(clockingThing % 400 == 0){
-            outs() << clockingThing << "\n";
+        int processed = ++clockingThing;
+        if(processed % 400 == 0){
+            #pragma omp critical(progressOutput)
+            outs() << processed << "\n";
         }
 
         FunctionInstance functionInstance;
+        // only set if the parser skipped the body
+        SourceRange skippedBodyRange;
 
         functionInstance.name = functionDecl->getNameAsString();
         functionInstance.returnType = functionDecl->getDeclaredReturnType().getAsString();
@@ -306,7 +389,7 @@ public:
         }
 
         // gets the File Name
-        functionInstance.filename = getFunctionDeclFilename(functionDecl, Context, dir);
+        functionInstance.filename = getFileInfo(functionDecl->getBeginLoc()).filename;
 
         // save the qualified name of the function
         functionInstance.qualifiedName = functionDecl->getQualifiedNameAsString();
@@ -325,11 +408,19 @@ public:
                 SourceRange sourceRange = functionDecl->getBody()->getSourceRange();
                 functionInstance.body = Lexer::getSourceText(CharSourceRange::getTokenRange(sourceRange), functionDecl->getASTContext().getSourceManager(), LangOptions(), nullptr).str();
 
+            }else if(functionDecl->hasSkippedBody()){
+                // header-only mode: the body is only read from the source, it is never parsed
+                skippedBodyRange = getSkippedBodyRange(functionDecl, Context);
+                if(skippedBodyRange.isValid()){
+                    functionInstance.body = Lexer::getSourceText(CharSourceRange::getTokenRange(skippedBodyRange), functionDecl->getASTContext().getSourceManager(), LangOptions(), nullptr).str();
+                }
             }
         } else {
             // marks the function as a Declaration and doesn't save the body
             functionInstance.isDeclaration = true;
         }
+        // computed once here, so the rename detection does not normalize the bodies for every pair of functions
+        functionInstance.bodyHash = helper::getNormalizedBodyHash(functionInstance.body);
         // get the scope of the functions (for some reason global functions don't have an access value, so it is set manually)
         if(getAccessSpelling(functionDecl->getAccess()).empty()){
             functionInstance.scope = "public";
@@ -339,15 +430,19 @@ public:
 
         SourceManager &sourceManager = functionDecl->getASTContext().getSourceManager();
         SourceRange sourceRange = functionDecl->getSourceRange();
+        // without the body the range of the declaration ends at the parameters, so it is extended to the body to get the same header as with the body
+        if(skippedBodyRange.isValid()){
+            sourceRange.setEnd(skippedBodyRange.getEnd());
+        }
         auto entireHeader = Lexer::getSourceText(CharSourceRange::getTokenRange(sourceRange), sourceManager, LangOptions(), nullptr).str();
         entireHeader = entireHeader.substr(0, entireHeader.find('{'));
         entireHeader.erase(std::remove(entireHeader.begin(), entireHeader.end(), '\n'), entireHeader.end());
 
-        functionInstance.filePosition = getLocation(functionDecl, dir, Context);
+        functionInstance.filePosition = getFilePosition(functionDecl->getBeginLoc());
 
         functionInstance.fullHeader = entireHeader;
 
-        functionInstance.declarations.push_back(functionInstance);
+        functionInstance.declarations.push_back(functionInstance.getDeclarationEntry());
 
         return functionInstance;
     }
@@ -355,9 +450,10 @@ public:
     VariableInstance createVariableInstance(VarDecl* varDecl){
         variableanalysis::VariableInstance variableInstance;
 
-        clockingThing++;
-        if(clockingThing % 400 == 0){
-            outs() << clockingThing << "\n";
+        int processed = ++clockingThing;
+        if(processed % 400 == 0){
+            #pragma omp critical(progressOutput)
+            outs() << processed << "\n";
         }
 
         variableInstance.isClassMember = false;
@@ -378,7 +474,7 @@ public:
         }
         variableInstance.type = fullType;
 
-        variableInstance.filename = getVarDeclFilename(varDecl, Context, dir);
+        variableInstance.filename = getFileInfo(varDecl->getBeginLoc()).filename;
 
         // gets a vector of all the classes / namespaces a variable is part of e.g. simple::example::function() -> [simple, example]
         std::string fullName = varDecl->getQualifiedNameAsString();
@@ -443,7 +539,7 @@ public:
             variableInstance.isMutable = false;
         }
 
-        variableInstance.filePosition = getLocation(varDecl, dir, Context);
+        variableInstance.filePosition = getFilePosition(varDecl->getBeginLoc());
 
         return variableInstance;
     }
@@ -453,9 +549,10 @@ public:
         variableInstance.isClassMember = true;
         variableInstance.isInline = false;
 
-        clockingThing++;
-        if(clockingThing % 400 == 0){
-            outs() << clockingThing << "\n";
+        int processed = ++clockingThing;
+        if(processed % 400 == 0){
+            #pragma omp critical(progressOutput)
+            outs() << processed << "\n";
         }
 
         variableInstance.name = decl->getNameAsString();
@@ -469,8 +566,8 @@ public:
         }
         variableInstance.type = fullType;
 
-        variableInstance.filename = getVarDeclFilename(decl, Context, dir);
-        variableInstance.filePosition = getLocation(decl, dir, Context);
+        variableInstance.filename = getFileInfo(decl->getBeginLoc()).filename;
+        variableInstance.filePosition = getFilePosition(decl->getBeginLoc());
 
         // gets a vector of all the classes / namespaces a variable is part of e.g. simple::example::function() -> [simple, example]
         std::string fullName = decl->getQualifiedNameAsString();
@@ -544,12 +641,10 @@ public:
             fullName.erase(0, pos + delimiter.length());
         }
 
-        objectInstance.filePosition = getLocation(recordDecl, dir, Context);
+        objectInstance.filePosition = getFilePosition(recordDecl->getBeginLoc());
 
         // gets the File Name
-        FullSourceLoc FullLocation = Context->getFullLoc(recordDecl->getBeginLoc());
-        auto filename = std::filesystem::relative(std::filesystem::path(FullLocation.getManager().getFilename(recordDecl->getBeginLoc()).str()), dir);
-        objectInstance.filename = filename;
+        objectInstance.filename = getFileInfo(recordDecl->getBeginLoc()).filename;
 
         objectInstance.objectType = recordDecl->getTagKind();
 
@@ -570,87 +665,35 @@ public:
     }
 
     bool VisitRecordDecl(clang::RecordDecl *recordDecl){
-        auto filename = getRecordDeclFilename(recordDecl, Context, dir);
-        if(std::find(files.begin(), files.end(), filename) == files.end()){
+        if(!isInProjectFile(recordDecl->getBeginLoc())){
             return true;
         }
 
-        if(findObjectInstance(objects, getLocation(recordDecl, dir, Context)) != -1){
-            return true;
-        }
-
-        auto objectInstance = createObjectInstance(recordDecl);
-        this->objects->push_back(objectInstance);
+        sink->addObject(getFilePosition(recordDecl->getBeginLoc()), [&](){ return createObjectInstance(recordDecl); });
 
         return true;
     }
 
     bool VisitFunctionDecl(clang::FunctionDecl *functionDecl){
-        auto filename = getFunctionDeclFilename(functionDecl, Context, dir);
-        if(std::find(files.begin(), files.end(), filename) == files.end()){
+        const FileInfo& fileInfo = getFileInfo(functionDecl->getBeginLoc());
+        if(!fileInfo.isProjectFile){
+            return true;
+        }
+        // declarations in skipped files are still needed if their definition is known, since the earlier translation unit might not have known it
+        if(fileInfo.isSkipped && (functionDecl->isThisDeclarationADefinition() || !(functionDecl->isDefined() || functionDecl->getDefinition()))){
             return true;
         }
 
         if(!functionDecl->isThisDeclarationADefinition()){
             if(functionDecl->isDefined() || functionDecl->getDefinition()){
-                auto position = findFunctionInstance(program, getLocation(functionDecl->getDefinition(), dir, Context));
-                if(position != -1){
-                    auto loc = getLocation(functionDecl, dir, Context);
-                    for (const auto &item: program->at(position).declarations){
-                        if(item.filePosition == loc){
-                            return true;
-                        }
-                    }
-
-                    FunctionInstance functionInstance;
-                    if(mapOfDeclarations->find(getLocation(functionDecl, dir, Context)) != mapOfDeclarations->end()){
-                        functionInstance = mapOfDeclarations->at(getLocation(functionDecl, dir, Context));
-                    }else{
-                        functionInstance = createFunctionInstance(functionDecl);
-                        mapOfDeclarations->insert(make_pair(getLocation(functionDecl, dir, Context), functionInstance));
-                    }
-
-                    program->at(position).declarations.push_back(functionInstance);
-                }else{
-                    FunctionInstance functionInstance;
-                    if(mapOfDeclarations->find(getLocation(functionDecl, dir, Context)) != mapOfDeclarations->end()){
-                        functionInstance = mapOfDeclarations->at(getLocation(functionDecl, dir, Context));
-                    }else{
-                        functionInstance = createFunctionInstance(functionDecl);
-                        mapOfDeclarations->insert(make_pair(getLocation(functionDecl, dir, Context), functionInstance));
-                    }
-
-                    // some definition filenames are empty (about 7 out of 11000 and no idea why), so the filename is set to the declaration filename
-                    FunctionInstance definition;
-                    if(getFunctionDeclFilename(functionDecl->getDefinition(), Context, dir) == ""){
-                        auto filePosition = getLocation(functionDecl->getDefinition(), dir, Context);
-                        if(findFunctionInstance(program, functionInstance.filename + "{err}" + filePosition) != -1){
-                            return true;
-                        }
-                        definition = createFunctionInstance(functionDecl->getDefinition());
-                        definition.filename = functionInstance.filename;
-                        definition.filePosition = functionInstance.filename + "{err}" + filePosition;
-                        definition.declarations[0].filename = definition.filename;
-                        definition.declarations[0].filePosition = definition.filePosition;
-                    }else{
-                        definition = createFunctionInstance(functionDecl->getDefinition());
-                    }
-                    definition.declarations.push_back(functionInstance);
-                    program->push_back(definition);
-                }
+                FunctionDecl* definition = functionDecl->getDefinition();
+                sink->addDefinedFunctionDeclaration(getFilePosition(functionDecl->getBeginLoc()), [&](){ return createFunctionInstance(functionDecl); },
+                                                    getFilePosition(definition->getBeginLoc()), getFileInfo(definition->getBeginLoc()).filename.empty(), [&](){ return createFunctionInstance(definition); });
             }else{
-
-                if(mapOfDeclarations->find(getLocation(functionDecl, dir, Context)) != mapOfDeclarations->end()){
-                    return true;
-                }
-                auto functionInstance = createFunctionInstance(functionDecl);
-                mapOfDeclarations->insert(make_pair(getLocation(functionDecl, dir, Context), functionInstance));
+                sink->addFunctionDeclaration(getFilePosition(functionDecl->getBeginLoc()), [&](){ return createFunctionInstance(functionDecl); });
             }
         }else{
-            if(findFunctionInstance(program, getLocation(functionDecl, dir, Context)) == -1){
-                auto functionInstance = createFunctionInstance(functionDecl);
-                program->push_back(functionInstance);
-            }
+            sink->addFunctionDefinition(getFilePosition(functionDecl->getBeginLoc()), [&](){ return createFunctionInstance(functionDecl); });
         }
         return true;
     };
@@ -661,35 +704,21 @@ public:
             return true;
         }
 
-        auto filename = getVarDeclFilename(varDecl, Context, dir);
-        if(std::find(files.begin(), files.end(), filename) == files.end()){
+        if(!isInProjectFile(varDecl->getBeginLoc())){
             return true;
         }
 
-        VariableInstance variableInstance;
-        if(findVariableInstance(variables, getLocation(varDecl, dir, Context)) != -1){
-            return true;
-        }
-        
-        variableInstance = createVariableInstance(varDecl);
-        variables->push_back(variableInstance);
+        sink->addVariable(getFilePosition(varDecl->getBeginLoc()), [&](){ return createVariableInstance(varDecl); });
 
         return true;
     }
 
     bool VisitFieldDecl(clang::FieldDecl* decl){
-        auto filename = getVarDeclFilename(decl, Context, dir);
-        if(std::find(files.begin(), files.end(), filename) == files.end()){
+        if(!isInProjectFile(decl->getBeginLoc())){
             return true;
         }
 
-        VariableInstance variableInstance;
-
-        if(findVariableInstance(variables, getLocation(decl, dir, Context)) != -1){
-            return true;
-        }
-        variableInstance = createVariableInstance(decl);
-        variables->push_back(variableInstance);
+        sink->addVariable(getFilePosition(decl->getBeginLoc()), [&](){ return createVariableInstance(decl); });
 
         return true;
     }
@@ -701,40 +730,50 @@ private:
 
 class APIAnalysisConsumer : public clang::ASTConsumer {
 public:
-    explicit APIAnalysisConsumer(clang::ASTContext *Context, std::vector<FunctionInstance>* program, std::string dir, std::vector<variableanalysis::VariableInstance>* var, std::vector<objectanalysis::ObjectInstance>* objects, std::vector<std::string>& files, std::map<std::string, FunctionInstance>* mapOfDeclarations, std::map<std::string, VariableInstance>* variableDefinitions) : apiAnalysisVisitor(Context, program, dir, var, objects, files, mapOfDeclarations, variableDefinitions){}
+    explicit APIAnalysisConsumer(clang::ASTContext *Context, ExtractionSink* sink, std::string dir, const std::unordered_set<std::string>* projectFiles, FileTable* fileTable, std::vector<std::string>* includedFiles, const std::unordered_set<std::string>* skippedFiles) : apiAnalysisVisitor(Context, sink, dir, projectFiles, fileTable, skippedFiles){
+        this->includedFiles = includedFiles;
+    }
 
     virtual void HandleTranslationUnit(clang::ASTContext &Context) {
         //outs()<<"File is: " + filesystem::current_path().string()<<"\n";
         apiAnalysisVisitor.TraverseDecl(Context.getTranslationUnitDecl());
+
+        // all files that were read for the translation unit (needed to check if a cached translation unit is still up to date)
+        if(includedFiles != nullptr){
+            collectIncludedFiles(Context.getSourceManager(), includedFiles);
+        }
     }
 
 private:
     APIAnalysisVisitor apiAnalysisVisitor;
+    std::vector<std::string>* includedFiles;
 };
 
 
 class APIAnalysisAction : public clang::ASTFrontendAction {
-    std::vector<FunctionInstance>* p;
+    ExtractionSink* sink;
     std::string directory;
-    std::vector<variableanalysis::VariableInstance>* var;
-    std::vector<objectanalysis::ObjectInstance>* obj;
-    std::vector<std::string> files;
-    std::map<std::string, FunctionInstance>* mapOfDeclarations;
-    std::map<std::string, VariableInstance>* variableDefinitions;
+    const std::unordered_set<std::string>* projectFiles;
+    FileTable* fileTable;
+    std::vector<std::string>* includedFiles;
+    const std::unordered_set<std::string>* skippedFiles;
+    bool skipFunctionBodies;
 public:
-    explicit APIAnalysisAction(std::vector<FunctionInstance>* program, std::string dir, std::vector<variableanalysis::VariableInstance>* var, std::vector<objectanalysis::ObjectInstance>* objects, std::vector<std::string> files, std::map<std::string, FunctionInstance>* mapOfDeclarations, std::map<std::string, VariableInstance>* variableDefinitions){
-        this->p=program;
+    explicit APIAnalysisAction(ExtractionSink* sink, std::string dir, const std::unordered_set<std::string>* projectFiles, FileTable* fileTable, std::vector<std::string>* includedFiles, const std::unordered_set<std::string>* skippedFiles, bool skipFunctionBodies){
+        this->sink = sink;
         this->directory = dir;
-        this->var = var;
-        this->obj = objects;
-        this->files = files;
-        this->mapOfDeclarations = mapOfDeclarations;
-        this->variableDefinitions = variableDefinitions;
+        this->projectFiles = projectFiles;
+        this->fileTable = fileTable;
+        this->includedFiles = includedFiles;
+        this->skippedFiles = skippedFiles;
+        this->skipFunctionBodies = skipFunctionBodies;
     };
 
     virtual std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance &Compiler, llvm::StringRef InFile) {
         //Compiler.getDiagnostics().setClient(new clang::IgnoringDiagConsumer(), true);
-        return std::make_unique<APIAnalysisConsumer>(&Compiler.getASTContext(), p, directory, var, obj, files, mapOfDeclarations, variableDefinitions);
+        // the parser reads the option after the consumer is created, the bodies are then only checked for matching braces
+        Compiler.getFrontendOpts().SkipFunctionBodies = skipFunctionBodies;
+        return std::make_unique<APIAnalysisConsumer>(&Compiler.getASTContext(), sink, directory, projectFiles, fileTable, includedFiles, skippedFiles);
     }
 
 private:
@@ -755,11 +794,11 @@ std::vector<FunctionInstance> assignDeclarations(std::vector<FunctionInstance>&
             }
             // if the current is a matching declaration, it is added to the FunctionItem item
             if(item.isCorrectDeclaration(otherItem)){
-                item.declarations.push_back(otherItem);
+                item.declarations.push_back(otherItem.getDeclarationEntry());
                 usedDeclarations.push_back(otherItem);
             }
         }
-        item.declarations.push_back(item);
+        item.declarations.push_back(item.getDeclarationEntry());
     }
 
     // delete all the declarations from the list
@@ -769,7 +808,7 @@ std::vector<FunctionInstance> assignDeclarations(std::vector<FunctionInstance>&
         if (!(functions.at(i).isDeclaration && std::find_if(usedDeclarations.begin(), usedDeclarations.end(),[functions, i](const FunctionInstance& func){return functions.at(i).qualifiedName == func.qualifiedName;})!=usedDeclarations.end())) {
             // any declaration that is still included has no definition and therefore should also reference itself in the declaration vector (to minimize border case handling the analyser)
             if(functions.at(i).isDeclaration){
-                functions.at(i).declarations.push_back(functions.at(i));
+                functions.at(i).declarations.push_back(functions.at(i).getDeclarationEntry());
             }
             output.push_back(functions.at(i));
         }
@@ -843,7 +882,7 @@ std::vector<FunctionInstance> assignSpecializations(std::vector<FunctionInstance
     return output;
 }
 
-void insertUndefinedDeclarations(vector<FunctionInstance>* definitions, map<std::string, FunctionInstance>* declarations) {
+void insertUndefinedDeclarations(vector<FunctionInstance>* definitions, unordered_map<FilePosition, FunctionInstance, FilePositionHash>* declarations, const FileTable& fileTable) {
     outs()<<"Started with " << declarations->size() << " declarations\n";
     for (auto &def : *definitions) {
         for (const auto &decl: def.declarations){
@@ -852,8 +891,15 @@ void insertUndefinedDeclarations(vector<FunctionInstance>* definitions, map<std:
     }
 
     outs()<<"There are " << declarations->size() << " undefined declarations\n";
+    // the declarations are added in the order of their positions as text, so the order does not depend on the ids of the files
+    vector<pair<std::string, FunctionInstance*>> undefinedDeclarations;
+    undefinedDeclarations.reserve(declarations->size());
     for (auto &item: *declarations){
-        definitions->push_back(item.second);
+        undefinedDeclarations.emplace_back(fileTable.format(item.first), &item.second);
+    }
+    std::sort(undefinedDeclarations.begin(), undefinedDeclarations.end(), [](const pair<std::string, FunctionInstance*>& a, const pair<std::string, FunctionInstance*>& b){ return a.first < b.first; });
+    for (const auto &item: undefinedDeclarations){
+        definitions->push_back(*item.second);
     }
 }
 /*
@@ -872,6 +918,192 @@ void insertUndeclaredVariables(vector<VariableInstance> *declarations, map<std::
 }
  */
 
+ClangTool createTool(const std::string& file, const CompilationDatabase& compilationDatabase, const std::vector<ArgumentsAdjuster>& argumentsAdjusters){
+    // every tool gets its own physical file system, because the default one changes the working directory of the whole process for each compile command
+    ClangTool tool = ClangTool(compilationDatabase, std::vector<std::string>{file}, std::make_shared<PCHContainerOperations>(),
+                               llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>(llvm::vfs::createPhysicalFileSystem().release()));
+    for (const auto &adjuster: argumentsAdjusters){
+        tool.appendArgumentsAdjuster(adjuster);
+    }
+    return tool;
+}
+
+// returns 0 if every compile command of the file could be processed
+int runExtraction(const std::string& file, const CompilationDatabase& compilationDatabase, const std::vector<ArgumentsAdjuster>& argumentsAdjusters, const std::string& directory, const std::unordered_set<std::string>& projectFiles, FileTable* fileTable, ExtractionSink* sink, std::vector<std::string>* includedFiles = nullptr, const std::unordered_set<std::string>* skippedFiles = nullptr, bool skipFunctionBodies = false){
+    ClangTool tool = createTool(file, compilationDatabase, argumentsAdjusters);
+    return tool.run(argumentParsingFrontendActionFactory<APIAnalysisAction>(sink, directory, &projectFiles, fileTable, includedFiles, skippedFiles, skipFunctionBodies).get());
+}
+
+// the compile commands of the file after all adjustments (part of the key of the cache)
+std::string getCompileCommand(const std::string& file, const CompilationDatabase& compilationDatabase, const std::vector<ArgumentsAdjuster>& argumentsAdjusters){
+    std::string command;
+    for (const auto &compileCommand: compilationDatabase.getCompileCommands(file)){
+        CommandLineArguments arguments = compileCommand.CommandLine;
+        for (const auto &adjuster: argumentsAdjusters){
+            arguments = adjuster(arguments, compileCommand.Filename);
+        }
+        command += compileCommand.Directory;
+        for (const auto &argument: arguments){
+            command += " " + argument;
+        }
+        command += "\n";
+    }
+    return command;
+}
+
+// extracts a translation unit into the buffer, either from the cache or by parsing it (which also updates the cache)
+void extractTranslationUnit(const std::string& file, const CompilationDatabase& compilationDatabase, const std::vector<ArgumentsAdjuster>& argumentsAdjusters, const std::string& directory, const std::unordered_set<std::string>& projectFiles, FileTable* fileTable, TranslationUnitBuffer* buffer, ExtractionCache* cache, const std::unordered_set<std::string>* skippedFiles, bool skipFunctionBodies){
+    // cached translation units always contain all of their files, since the earlier translation units can differ between runs
+    if(cache == nullptr){
+        runExtraction(file, compilationDatabase, argumentsAdjusters, directory, projectFiles, fileTable, buffer, nullptr, skippedFiles, skipFunctionBodies);
+        return;
+    }
+
+    std::string absoluteFile = std::filesystem::absolute(file).string();
+    std::string command = getCompileCommand(absoluteFile, compilationDatabase, argumentsAdjusters);
+    // the bodies of the header-only mode are read differently, so both modes have their own entries
+    if(skipFunctionBodies){
+        command += "header-only\n";
+    }
+    if(cache->load(absoluteFile, command, fileTable, buffer)){
+        return;
+    }
+    std::vector<std::string> includedFiles;
+    // translation units with errors are not cached, since the missing parts could be fixed without changing any of the read files (e.g. a new header)
+    if(runExtraction(file, compilationDatabase, argumentsAdjusters, directory, projectFiles, fileTable, buffer, &includedFiles, nullptr, skipFunctionBodies) == 0){
+        cache->store(absoluteFile, command, includedFiles, *fileTable, *buffer);
+    }
+}
+
+// reads a translation unit with the preprocessor only, which finds all files it includes without parsing it
+class IncludeScanAction : public clang::PreprocessOnlyAction {
+    std::vector<std::string>* includedFiles;
+public:
+    explicit IncludeScanAction(std::vector<std::string>* includedFiles){
+        this->includedFiles = includedFiles;
+    }
+
+protected:
+    void EndSourceFileAction() override {
+        collectIncludedFiles(getCompilerInstance().getSourceManager(), includedFiles);
+        PreprocessOnlyAction::EndSourceFileAction();
+    }
+};
+
+/*
+ * Finds the project files (canonical paths) that are part of every translation unit, including the file itself
+ * Files whose includes could not be determined (e.g. because of missing headers) have no entry
+ */
+std::map<std::string, std::vector<std::string>> scanIncludes(const std::vector<std::string>& files, const CompilationDatabase& compilationDatabase, const std::vector<ArgumentsAdjuster>& argumentsAdjusters, const std::unordered_set<std::string>& projectFiles, int jobs){
+    std::vector<std::vector<std::string>> includes(files.size());
+    std::vector<char> succeeded(files.size(), false);
+
+    #pragma omp parallel for schedule(dynamic) num_threads(std::max(1, jobs))
+    for(int i = 0; i < (int) files.size(); i++){
+        ClangTool tool = createTool(files.at(i), compilationDatabase, argumentsAdjusters);
+        // the errors are reported by the extraction
+        IgnoringDiagConsumer diagnosticConsumer;
+        tool.setDiagnosticConsumer(&diagnosticConsumer);
+        std::vector<std::string> includedFiles;
+        if(tool.run(argumentParsingFrontendActionFactory<IncludeScanAction>(&includedFiles).get()) != 0){
+            continue;
+        }
+        for (const auto &item: includedFiles){
+            auto canonicalFilename = std::filesystem::weakly_canonical(item).string();
+            if(projectFiles.count(canonicalFilename)){
+                includes.at(i).push_back(canonicalFilename);
+            }
+        }
+        succeeded.at(i) = true;
+    }
+
+    std::map<std::string, std::vector<std::string>> output;
+    for(int i = 0; i < (int) files.size(); i++){
+        if(succeeded.at(i)){
+            output.insert(std::make_pair(files.at(i), std::move(includes.at(i))));
+        }
+    }
+    return output;
+}
+
+// every project header is only extracted by the first translation unit (in the order of the files) that includes it, the later ones skip it
+std::vector<std::unordered_set<std::string>> getSkippedFiles(const std::vector<std::string>& files, const std::map<std::string, std::vector<std::string>>& includes){
+    std::vector<std::unordered_set<std::string>> skippedFiles(files.size());
+    std::unordered_set<std::string> extractedFiles;
+    for(int i = 0; i < (int) files.size(); i++){
+        auto found = includes.find(files.at(i));
+        // without the includes it is unknown what the translation unit extracts, so nothing is skipped and it is not the first for any header
+        if(found == includes.end()){
+            continue;
+        }
+        auto mainFile = std::filesystem::weakly_canonical(files.at(i)).string();
+        for (const auto &item: found->second){
+            if(item != mainFile && extractedFiles.count(item)){
+                skippedFiles.at(i).insert(item);
+            }
+        }
+        extractedFiles.insert(found->second.begin(), found->second.end());
+    }
+    return skippedFiles;
+}
+
+/*
+ * Extracts all functions, variables and objects of the given files into the state
+ * With more than one job the translation units are extracted in parallel into separate buffers, which are merged in the order of the files, so the result is identical to the serial extraction
+ */
+void extractProject(const std::vector<std::string>& files, const CompilationDatabase& compilationDatabase, const std::vector<ArgumentsAdjuster>& argumentsAdjusters, const std::string& directory, const std::unordered_set<std::string>& projectFiles, ExtractionState* state, int jobs, const std::string& version, ExtractionCache* cache, const std::vector<std::unordered_set<std::string>>* skippedFiles, bool skipFunctionBodies){
+    if(jobs <= 1){
+        int fileCounter = 0;
+        for (int i = 0; i < (int) files.size(); i++){
+            const auto &item = files.at(i);
+            fileCounter++;
+            if(fileCounter % 100 == 0){
+                #pragma omp critical(progressOutput)
+                outs()<<"Processing file " + itostr(fileCounter) + "/" + itostr(files.size()) + " of the " + version + " version\n";
+            }
+            if(cache == nullptr){
+                runExtraction(item, compilationDatabase, argumentsAdjusters, directory, projectFiles, &state->fileTable, state, nullptr, skippedFiles == nullptr ? nullptr : &skippedFiles->at(i), skipFunctionBodies);
+            }else{
+                // cached translation units are replayed, which results in the same state as the direct extraction
+                TranslationUnitBuffer buffer;
+                extractTranslationUnit(item, compilationDatabase, argumentsAdjusters, directory, projectFiles, &state->fileTable, &buffer, cache, skippedFiles == nullptr ? nullptr : &skippedFiles->at(i), skipFunctionBodies);
+                state->replay(buffer);
+            }
+        }
+        return;
+    }
+
+    std::vector<std::unique_ptr<TranslationUnitBuffer>> buffers(files.size());
+    std::vector<bool> finished(files.size(), false);
+    size_t nextToMerge = 0;
+    int fileCounter = 0;
+    // not a named critical section, since the old and the new version are extracted at the same time
+    std::mutex mergeMutex;
+
+    #pragma omp parallel for schedule(dynamic) num_threads(jobs)
+    for(int i = 0; i < (int) files.size(); i++){
+        auto buffer = std::make_unique<TranslationUnitBuffer>();
+        extractTranslationUnit(files.at(i), compilationDatabase, argumentsAdjusters, directory, projectFiles, &state->fileTable, buffer.get(), cache, skippedFiles == nullptr ? nullptr : &skippedFiles->at(i), skipFunctionBodies);
+
+        // buffers are merged as soon as all previous files are merged, so only the buffers of the files that are currently processed are kept in memory
+        {
+            std::lock_guard<std::mutex> lock(mergeMutex);
+            buffers.at(i) = std::move(buffer);
+            finished.at(i) = true;
+            while(nextToMerge < files.size() && finished.at(nextToMerge)){
+                state->replay(*buffers.at(nextToMerge));
+                buffers.at(nextToMerge).reset();
+                nextToMerge++;
+            }
+            fileCounter++;
+            if(fileCounter % 100 == 0){
+                #pragma omp critical(progressOutput)
+                outs()<<"Processing file " + itostr(fileCounter) + "/" + itostr(files.size()) + " of the " + version + " version\n";
+            }
+        }
+    }
+}
+
 int main(int argc, const char **argv) {
     cxxopts::Options options("APIAnalysis", "Compares two versions of a C++ API and prints out the differences");
     options.add_options()
@@ -891,6 +1123,15 @@ int main(int argc, const char **argv) {
             ("ignore-CD-files, iCDf", "Forcefully ignore the files found in the Compilation Database and instead use the files found by manually searching the given folders")
             ("ignore-CD-files-old, iCDfO", "Forcefully ignore the files found in the Compilation Database of the old project and instead use the files found by manually searching the given folders")
             ("ignore-CD-files-new, iCDfN", "Forcefully ignore the files found in the Compilation Database of the new project and instead use the files found by manually searching the given folders")
+            ("jobs, j", "Number of threads used to extract the translation units, split between the old and the new project which are extracted at the same time (the result is identical to the extraction with a single thread)", cxxopts::value<int>()->default_value("1"))
+            ("cache-dir, cache", "Directory in which the extracted translation units are cached, unchanged translation units are not parsed again in later runs", cxxopts::value<std::string>())
+            ("emit-snapshot-old", "Write the extracted old version of the project to a binary snapshot at the given path", cxxopts::value<std::string>())
+            ("emit-snapshot-new", "Write the extracted new version of the project to a binary snapshot at the given path", cxxopts::value<std::string>())
+            ("load-snapshot-old", "Load the old version of the project from a snapshot instead of extracting it", cxxopts::value<std::string>())
+            ("load-snapshot-new", "Load the new version of the project from a snapshot instead of extracting it", cxxopts::value<std::string>())
+            ("rename-candidates", "Only compare the body of a removed function with the given number of most similar bodies (found with a MinHash index) when searching for renamed functions with --doc, instead of all bodies (0 = all)", cxxopts::value<int>()->default_value("0"))
+            ("token-similarity", "Compare the function bodies by their tokens instead of their characters (the statistical comparison of --doc and the comparison of overloaded functions), so the formatting and the length of identifiers do not change the similarity")
+            ("header-only", "Skip the function bodies while parsing (much faster and less memory), the bodies are only read from the source for the detection of renamed functions - not possible with --doc")
             ("h,help", "Print usage")
             ;
     auto result = options.parse(argc, argv);
@@ -938,6 +1179,12 @@ int main(int argc, const char **argv) {
 
     bool docEnabled = result["doc"].as<bool>();
 
+    bool headerOnly = result["header-only"].as<bool>();
+    // the bodies read from the source are only good enough for the exact comparison (e.g. preprocessor branches inside of a body are not resolved)
+    if(headerOnly && docEnabled){
+        throw std::invalid_argument("--header-only can not be combined with --doc, since the statistical comparison needs the bodies seen by the parser");
+    }
+
     bool outputPrivateFunctions = result["ipf"].as<bool>();
 
     bool jsonOutput = result["json"].as<bool>();
@@ -946,6 +1193,8 @@ int main(int argc, const char **argv) {
     bool ignoreCDFilesOld = result["ignore-CD-files-old"].as<bool>();
     bool ignoreCDFilesNew = result["ignore-CD-files-new"].as<bool>();
 
+    int jobs = result["jobs"].as<int>();
+
     // lists of functions
     std::vector<FunctionInstance> oldProgram;
     std::vector<FunctionInstance> newProgram;
@@ -963,17 +1212,17 @@ int main(int argc, const char **argv) {
     std::unique_ptr<CompilationDatabase> newCD;
 
 
-    std::vector<std::string> relativeListOfOldFiles;
-    std::vector<std::string> relativeListOfNewFiles;
+    std::unordered_set<std::string> oldProjectFiles;
+    std::unordered_set<std::string> newProjectFiles;
 
-    // fill relativeLists at this point, because the iterated files are needed during the extraction to distinguish between project files and library files (not doing this can lead to headers being ignored)
-    relativeListOfOldFiles.reserve(oldFiles.size());
+    // fill the sets of project files at this point, because the iterated files are needed during the extraction to distinguish between project files and library files (not doing this can lead to headers being ignored)
+    oldProjectFiles.reserve(oldFiles.size());
     for (const auto &item: oldFiles){
-        relativeListOfOldFiles.push_back(std::filesystem::relative(item, std::filesystem::canonical(std::filesystem::absolute(result["oldDir"].as<std::string>()))).string());
+        oldProjectFiles.insert(std::filesystem::weakly_canonical(item).string());
     }
-    relativeListOfNewFiles.reserve(newFiles.size());
+    newProjectFiles.reserve(newFiles.size());
     for (const auto &item: newFiles){
-        relativeListOfNewFiles.push_back(std::filesystem::relative(item, std::filesystem::canonical(std::filesystem::absolute(result["newDir"].as<std::string>()))).string());
+        newProjectFiles.insert(std::filesystem::weakly_canonical(item).string());
     }
 
     // TODO null check for autodetect CD
@@ -1029,64 +1278,153 @@ int main(int argc, const char **argv) {
         newCD = FixedCompilationDatabase::loadFromBuffer(".","",errorMessage);
     }
 
-    auto [filteredOld, filteredNew] = helper::filterUnchangedFiles(oldFiles, newFiles, result["oldDir"].as<std::string>(), result["newDir"].as<std::string>());
+    std::vector<ArgumentsAdjuster> oldArgumentsAdjusters;
+    std::vector<ArgumentsAdjuster> newArgumentsAdjusters;
+    if(result.count("extra-args")) {
+        CommandLineArguments args = result["extra-args"].as<std::vector<std::string>>();
+        oldArgumentsAdjusters.push_back(clang::tooling::getInsertArgumentAdjuster(args, ArgumentInsertPosition::BEGIN));
+        newArgumentsAdjusters.push_back(clang::tooling::getInsertArgumentAdjuster(args, ArgumentInsertPosition::BEGIN));
+    }
+
+    if(result.count("extra-args-old")) {
+        CommandLineArguments args = result["extra-args-old"].as<std::vector<std::string>>();
+        oldArgumentsAdjusters.push_back(clang::tooling::getInsertArgumentAdjuster(args, ArgumentInsertPosition::BEGIN));
+    }
+
+    if(result.count("extra-args-new")) {
+        CommandLineArguments args = result["extra-args-new"].as<std::vector<std::string>>();
+        newArgumentsAdjusters.push_back(clang::tooling::getInsertArgumentAdjuster(args, ArgumentInsertPosition::BEGIN));
+    }
+
+    std::string oldDirectory = std::filesystem::canonical(std::filesystem::absolute(result["oldDir"].as<std::string>()));
+    std::string newDirectory = std::filesystem::canonical(std::filesystem::absolute(result["newDir"].as<std::string>()));
 
-    outs() << "The number of files that were filtered out because they were unchanged is " << oldFiles.size() - filteredOld.size() << " for the old project and " << newFiles.size() - filteredNew.size() << " for the new project\n";
-    outs() << "Final number of files is " << filteredOld.size() << " for the old project and " << filteredNew.size() << " for the new project\n";
-    oldFiles = filteredOld;
-    newFiles = filteredNew;
+    // the project files included by each translation unit (only known if unchanged files are filtered out)
+    std::map<std::string, std::vector<std::string>> oldIncludes;
+    std::map<std::string, std::vector<std::string>> newIncludes;
+
+    bool loadOldSnapshot = result.count("load-snapshot-old");
+    bool loadNewSnapshot = result.count("load-snapshot-new");
+
+    // a snapshot has to contain the whole version, since it is compared against other versions than the one it was extracted with
+    if(loadOldSnapshot || loadNewSnapshot || result.count("emit-snapshot-old") || result.count("emit-snapshot-new")){
+        outs() << "Unchanged files are not filtered out, because snapshots are used\n";
+    }else{
+        // a file with the same content still has to be analysed if one of the project files it includes has changed
+        outs() << "Scanning the includes of the translation units\n";
+        oldIncludes = scanIncludes(oldFiles, *oldCD, oldArgumentsAdjusters, oldProjectFiles, jobs);
+        newIncludes = scanIncludes(newFiles, *newCD, newArgumentsAdjusters, newProjectFiles, jobs);
+
+        std::mutex unchangedFilesMutex;
+        std::unordered_map<std::string, bool> unchangedFiles;
+        auto includesUnchanged = [&](const std::string& oldFile, const std::string& newFile){
+            auto oldIncluded = oldIncludes.find(oldFile);
+            auto newIncluded = newIncludes.find(newFile);
+            if(oldIncluded == oldIncludes.end() || newIncluded == newIncludes.end()){
+                return false;
+            }
+            std::set<std::string> oldRelativeFiles;
+            std::set<std::string> newRelativeFiles;
+            for (const auto &item: oldIncluded->second){
+                oldRelativeFiles.insert(std::filesystem::path(item).lexically_relative(oldDirectory).string());
+            }
+            for (const auto &item: newIncluded->second){
+                newRelativeFiles.insert(std::filesystem::path(item).lexically_relative(newDirectory).string());
+            }
+            if(oldRelativeFiles != newRelativeFiles){
+                return false;
+            }
+            for (const auto &item: newRelativeFiles){
+                {
+                    std::lock_guard<std::mutex> lock(unchangedFilesMutex);
+                    auto found = unchangedFiles.find(item);
+                    if(found != unchangedFiles.end()){
+                        if(!found->second){
+                            return false;
+                        }
+                        continue;
+                    }
+                }
+                bool unchanged = helper::filesAreEqual((std::filesystem::path(oldDirectory) / item).string(), (std::filesystem::path(newDirectory) / item).string());
+                std::lock_guard<std::mutex> lock(unchangedFilesMutex);
+                unchangedFiles.insert(std::make_pair(item, unchanged));
+                if(!unchanged){
+                    return false;
+                }
+            }
+            return true;
+        };
+        auto [filteredOld, filteredNew] = helper::filterUnchangedFiles(oldFiles, newFiles, result["oldDir"].as<std::string>(), result["newDir"].as<std::string>(), includesUnchanged, jobs);
 
-    std::map<std::string, FunctionInstance> mapOfDeclarations;
-    std::map<std::string, VariableInstance> variableDefinitions;
+        outs() << "The number of files that were filtered out because they were unchanged is " << oldFiles.size() - filteredOld.size() << " for the old project and " << newFiles.size() - filteredNew.size() << " for the new project\n";
+        outs() << "Final number of files is " << filteredOld.size() << " for the old project and " << filteredNew.size() << " for the new project\n";
+        oldFiles = filteredOld;
+        newFiles = filteredNew;
+    }
 
     outs()<<"In the old version " + itostr(oldFiles.size()) + " files are included in the analysis\n";
     outs()<<"In the new version " + itostr(newFiles.size()) + " files are included in the analysis\n";
 
-    int fileCounter = 0;
-    for (const auto &item: oldFiles){
-        fileCounter++;
-        if(fileCounter % 100 == 0) outs()<<"Processing file " + itostr(fileCounter) + "/" + itostr(oldFiles.size()) + "\n";
-        ClangTool oldTool = ClangTool(*oldCD,
-                                      std::vector<std::string>{item});
-        if(result.count("extra-args")) {
-            CommandLineArguments args = result["extra-args"].as<std::vector<std::string>>();
-            auto adjuster = clang::tooling::getInsertArgumentAdjuster(args, ArgumentInsertPosition::BEGIN);
-            oldTool.appendArgumentsAdjuster(adjuster);
+    // each version has its own declaration maps, so both versions are independent until the analysis and are extracted at the same time (the jobs are split between them)
+    ExtractionState oldState;
+    ExtractionState newState;
+    std::unique_ptr<ExtractionCache> oldCache;
+    std::unique_ptr<ExtractionCache> newCache;
+    if(result.count("cache-dir")){
+        oldCache = std::make_unique<ExtractionCache>(result["cache-dir"].as<std::string>(), oldDirectory, &oldProjectFiles);
+        newCache = std::make_unique<ExtractionCache>(result["cache-dir"].as<std::string>(), newDirectory, &newProjectFiles);
+    }
+    // the includes are needed to skip the headers that were already extracted by an earlier translation unit (not possible with the cache, since a cached translation unit has to be complete)
+    std::unique_ptr<std::vector<std::unordered_set<std::string>>> oldSkippedFiles;
+    std::unique_ptr<std::vector<std::unordered_set<std::string>>> newSkippedFiles;
+    if(!oldIncludes.empty() && !oldCache){
+        oldSkippedFiles = std::make_unique<std::vector<std::unordered_set<std::string>>>(getSkippedFiles(oldFiles, oldIncludes));
+    }
+    if(!newIncludes.empty() && !newCache){
+        newSkippedFiles = std::make_unique<std::vector<std::unordered_set<std::string>>>(getSkippedFiles(newFiles, newIncludes));
+    }
+    omp_set_max_active_levels(2);
+    #pragma omp parallel sections num_threads(2)
+    {
+        #pragma omp section
+        if(!loadOldSnapshot){
+            extractProject(oldFiles, *oldCD, oldArgumentsAdjusters, oldDirectory, oldProjectFiles, &oldState, std::max(1, (jobs + 1) / 2), "old", oldCache.get(), oldSkippedFiles.get(), headerOnly);
         }
-
-        if(result.count("extra-args-old")) {
-            CommandLineArguments args = result["extra-args-old"].as<std::vector<std::string>>();
-            auto adjuster = clang::tooling::getInsertArgumentAdjuster(args, ArgumentInsertPosition::BEGIN);
-            oldTool.appendArgumentsAdjuster(adjuster);
+        #pragma omp section
+        if(!loadNewSnapshot){
+            extractProject(newFiles, *newCD, newArgumentsAdjusters, newDirectory, newProjectFiles, &newState, std::max(1, jobs / 2), "new", newCache.get(), newSkippedFiles.get(), headerOnly);
         }
-        oldTool.run(argumentParsingFrontendActionFactory<APIAnalysisAction>(&oldProgram, std::filesystem::canonical(std::filesystem::absolute(result["oldDir"].as<std::string>())), &oldVariables, &oldObjects, relativeListOfOldFiles, &mapOfDeclarations, &variableDefinitions).get());
     }
+    // only the extraction runs nested, the matching of the functions starts a parallel region in each thread of its loop
+    omp_set_max_active_levels(1);
 
-    insertUndefinedDeclarations(&oldProgram, &mapOfDeclarations);
-
-    mapOfDeclarations.clear();
-    variableDefinitions.clear();
-    fileCounter = 0;
-    for (const auto &item: newFiles){
-        fileCounter++;
-        if(fileCounter % 100 == 0) outs()<<"Processing file " + itostr(fileCounter) + "/" + itostr(newFiles.size()) + "\n";
-        ClangTool newTool = ClangTool(*newCD,
-                                      std::vector<std::string>{item});
-        if(result.count("extra-args")) {
-            CommandLineArguments args = result["extra-args"].as<std::vector<std::string>>();
-            auto adjuster = clang::tooling::getInsertArgumentAdjuster(args, ArgumentInsertPosition::BEGIN);
-            newTool.appendArgumentsAdjuster(adjuster);
+    if(loadOldSnapshot){
+        if(!SnapshotReader().read(result["load-snapshot-old"].as<std::string>(), &oldProgram, &oldVariables, &oldObjects)){
+            throw std::runtime_error("The snapshot of the old version could not be loaded");
         }
-
-        if(result.count("extra-args-new")) {
-            CommandLineArguments args = result["extra-args-new"].as<std::vector<std::string>>();
-            auto adjuster = clang::tooling::getInsertArgumentAdjuster(args, ArgumentInsertPosition::BEGIN);
-            newTool.appendArgumentsAdjuster(adjuster);
+    }else{
+        insertUndefinedDeclarations(&oldState.program, &oldState.mapOfDeclarations, oldState.fileTable);
+        oldProgram = std::move(oldState.program);
+        oldVariables = std::move(oldState.variables);
+        oldObjects = std::move(oldState.objects);
+    }
+    if(loadNewSnapshot){
+        if(!SnapshotReader().read(result["load-snapshot-new"].as<std::string>(), &newProgram, &newVariables, &newObjects)){
+            throw std::runtime_error("The snapshot of the new version could not be loaded");
         }
-        newTool.run(argumentParsingFrontendActionFactory<APIAnalysisAction>(&newProgram, std::filesystem::canonical(std::filesystem::absolute(result["newDir"].as<std::string>())), &newVariables, &newObjects, relativeListOfNewFiles, &mapOfDeclarations, &variableDefinitions).get());
+    }else{
+        insertUndefinedDeclarations(&newState.program, &newState.mapOfDeclarations, newState.fileTable);
+        newProgram = std::move(newState.program);
+        newVariables = std::move(newState.variables);
+        newObjects = std::move(newState.objects);
     }
 
-    insertUndefinedDeclarations(&newProgram, &mapOfDeclarations);
+    if(result.count("emit-snapshot-old") && !SnapshotWriter().write(result["emit-snapshot-old"].as<std::string>(), oldProgram, oldVariables, oldObjects)){
+        outs() << "The snapshot of the old version could not be written\n";
+    }
+    if(result.count("emit-snapshot-new") && !SnapshotWriter().write(result["emit-snapshot-new"].as<std::string>(), newProgram, newVariables, newObjects)){
+        outs() << "The snapshot of the new version could not be written\n";
+    }
 
     outs()<<"All functions, objects and variables were processed\n";
     outs()<<"In total "<<oldProgram.size()<<" functions, "<<oldObjects.size()<<" objects and "<<oldVariables.size()<<" variables were found in the old version of the project\n";
@@ -1095,6 +1433,14 @@ int main(int argc, const char **argv) {
     oldProgram = assignSpecializations(oldProgram);
     newProgram = assignSpecializations(newProgram);
 
+    // both versions share the ids of the tokens
+    bool tokenSimilarity = result["token-similarity"].as<bool>();
+    if(tokenSimilarity){
+        matcher::TokenTable tokenTable;
+        tokenizeBodies(&oldProgram, &tokenTable, jobs);
+        tokenizeBodies(&newProgram, &tokenTable, jobs);
+    }
+
     OutputHandler* outputHandler;
     if(jsonOutput){
         outputHandler = new JSONOutputHandler();
@@ -1107,8 +1453,8 @@ int main(int argc, const char **argv) {
     objectAnalyser.compareObjects();
     outs()<<"The functionanalysis started " << oldProgram.size() << " funcs \n";
     // Analysing Functions
-    FunctionAnalyser analyser = FunctionAnalyser(oldProgram, newProgram, outputHandler);
-    analyser.compareVersionsWithDoc(docEnabled, outputPrivateFunctions);
+    FunctionAnalyser analyser = FunctionAnalyser(std::move(oldProgram), std::move(newProgram), outputHandler, jobs);
+    analyser.compareVersionsWithDoc(docEnabled, outputPrivateFunctions, result["rename-candidates"].as<int>(), tokenSimilarity);
     outs()<<"The variableanalysis started " << oldVariables.size() << " variables \n";
     // Analysing Variables
     variableanalysis::VariableAnalyser variableAnalyser = variableanalysis::VariableAnalyser(oldVariables, newVariables, outputHandler);
@@ -1,23 +1,27 @@
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 #include "header/CodeMatcher.h"
 #include <llvm/Support/CommandLine.h>
 #include "header/FunctionAnalyser.h"
 #include "header/HelperFunctions.h"
+#include <llvm/Support/xxhash.h>
+#include <clang/Basic/LangOptions.h>
+#include <clang/Lex/Lexer.h>
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
 
 
 namespace matcher{
 
     using namespace std;
 
-    vector<string> convertStringToVector(const string& str){
-        vector<string> output;
-        for (const auto &item: str){
-            output.push_back(to_string(item));
-        }
-        return output;
-    }
-
+    // the full matrix, only needed by the callers that backtrack through it to get the operations
     vector<vector<int>> levenshteinDistance(const vector<string>& s1, const vector<string>& s2){
         const size_t len1 = s1.size(), len2 = s2.size();
         vector<vector<int>> d(len1 + 1, vector<int>(len2 + 1));
@@ -32,15 +36,503 @@ namespace matcher{
         return d;
     }
 
+    /*
+     * One block of 64 rows of the bit-parallel edit distance (Myers 1999, with the blocks of Hyyrö 2003)
+     * A column of the matrix is stored as the vertical differences between its rows (positive in positiveVertical, negative in negativeVertical)
+     * horizontalIn is the difference of the row above the block between the previous and the current column, the returned values are the horizontal differences of all rows of the block
+     */
+    inline void calculateBlock(uint64_t& positiveVertical, uint64_t& negativeVertical, uint64_t equal, int horizontalIn, uint64_t& positiveHorizontal, uint64_t& negativeHorizontal){
+        uint64_t horizontalInNegative = horizontalIn < 0 ? 1 : 0;
+        uint64_t verticalChange = equal | negativeVertical;
+        equal |= horizontalInNegative;
+        uint64_t horizontalChange = (((equal & positiveVertical) + positiveVertical) ^ positiveVertical) | equal;
+        positiveHorizontal = negativeVertical | ~(horizontalChange | positiveVertical);
+        negativeHorizontal = positiveVertical & horizontalChange;
+
+        uint64_t shiftedPositive = (positiveHorizontal << 1) | (horizontalIn > 0 ? 1 : 0);
+        uint64_t shiftedNegative = (negativeHorizontal << 1) | horizontalInNegative;
+        positiveVertical = shiftedNegative | ~(verticalChange | shiftedPositive);
+        negativeVertical = shiftedPositive & verticalChange;
+    }
+
+    /*
+     * Length of the common beginning of two strings, compared in vector registers of the widest instruction set of the CPU (chosen at runtime)
+     * Each kernel compares whole registers and falls back to the bytes for the rest, the scalar kernel is used on other architectures
+     */
+    size_t commonPrefixLengthScalar(const char* s1, const char* s2, size_t length){
+        size_t i = 0;
+        while(i < length && s1[i] == s2[i]) ++i;
+        return i;
+    }
+
+    // the same from the end of the strings (the pointers point behind the last character)
+    size_t commonSuffixLengthScalar(const char* s1End, const char* s2End, size_t length){
+        size_t i = 0;
+        while(i < length && s1End[-1 - (long) i] == s2End[-1 - (long) i]) ++i;
+        return i;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("avx512f,avx512bw")))
+    size_t commonPrefixLengthAVX512(const char* s1, const char* s2, size_t length){
+        size_t i = 0;
+        for(; i + 64 <= length; i += 64){
+            uint64_t equal = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(s1 + i), _mm512_loadu_si512(s2 + i));
+            if(equal != ~uint64_t(0)){
+                return i + __builtin_ctzll(~equal);
+            }
+        }
+        return i + commonPrefixLengthScalar(s1 + i, s2 + i, length - i);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    size_t commonSuffixLengthAVX512(const char* s1End, const char* s2End, size_t length){
+        size_t i = 0;
+        for(; i + 64 <= length; i += 64){
+            uint64_t equal = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(s1End - i - 64), _mm512_loadu_si512(s2End - i - 64));
+            if(equal != ~uint64_t(0)){
+                return i + __builtin_clzll(~equal);
+            }
+        }
+        return i + commonSuffixLengthScalar(s1End - i, s2End - i, length - i);
+    }
+
+    __attribute__((target("avx2")))
+    size_t commonPrefixLengthAVX2(const char* s1, const char* s2, size_t length){
+        size_t i = 0;
+        for(; i + 32 <= length; i += 32){
+            __m256i a = _mm256_loadu_si256((const __m256i*) (s1 + i));
+            __m256i b = _mm256_loadu_si256((const __m256i*) (s2 + i));
+            uint32_t equal = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+            if(equal != ~uint32_t(0)){
+                return i + __builtin_ctz(~equal);
+            }
+        }
+        return i + commonPrefixLengthScalar(s1 + i, s2 + i, length - i);
+    }
+
+    __attribute__((target("avx2")))
+    size_t commonSuffixLengthAVX2(const char* s1End, const char* s2End, size_t length){
+        size_t i = 0;
+        for(; i + 32 <= length; i += 32){
+            __m256i a = _mm256_loadu_si256((const __m256i*) (s1End - i - 32));
+            __m256i b = _mm256_loadu_si256((const __m256i*) (s2End - i - 32));
+            uint32_t equal = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+            if(equal != ~uint32_t(0)){
+                return i + __builtin_clz(~equal);
+            }
+        }
+        return i + commonSuffixLengthScalar(s1End - i, s2End - i, length - i);
+    }
+
+    // SSE2 is part of every x86-64 CPU
+    size_t commonPrefixLengthSSE(const char* s1, const char* s2, size_t length){
+        size_t i = 0;
+        for(; i + 16 <= length; i += 16){
+            __m128i a = _mm_loadu_si128((const __m128i*) (s1 + i));
+            __m128i b = _mm_loadu_si128((const __m128i*) (s2 + i));
+            uint32_t equal = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+            if(equal != 0xFFFF){
+                return i + __builtin_ctz(~equal);
+            }
+        }
+        return i + commonPrefixLengthScalar(s1 + i, s2 + i, length - i);
+    }
+
+    size_t commonSuffixLengthSSE(const char* s1End, const char* s2End, size_t length){
+        size_t i = 0;
+        for(; i + 16 <= length; i += 16){
+            __m128i a = _mm_loadu_si128((const __m128i*) (s1End - i - 16));
+            __m128i b = _mm_loadu_si128((const __m128i*) (s2End - i - 16));
+            uint32_t equal = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+            if(equal != 0xFFFF){
+                // the mask has 16 bits, so the leading zeros of the upper half are not counted
+                return i + __builtin_clz(~equal << 16);
+            }
+        }
+        return i + commonSuffixLengthScalar(s1End - i, s2End - i, length - i);
+    }
+#endif
 
+    vector<CommonLengthKernels> getSupportedCommonLengthKernels(){
+        vector<CommonLengthKernels> kernels;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512bw")){
+            kernels.push_back(CommonLengthKernels{"avx512", commonPrefixLengthAVX512, commonSuffixLengthAVX512});
+        }
+        if(__builtin_cpu_supports("avx2")){
+            kernels.push_back(CommonLengthKernels{"avx2", commonPrefixLengthAVX2, commonSuffixLengthAVX2});
+        }
+        if(__builtin_cpu_supports("sse2")){
+            kernels.push_back(CommonLengthKernels{"sse2", commonPrefixLengthSSE, commonSuffixLengthSSE});
+        }
+#endif
+        kernels.push_back(CommonLengthKernels{"scalar", commonPrefixLengthScalar, commonSuffixLengthScalar});
+        return kernels;
+    }
+
+    const CommonLengthKernels& getCommonLengthKernels(){
+        static const CommonLengthKernels kernels = getSupportedCommonLengthKernels().front();
+        return kernels;
+    }
+
+    size_t commonPrefixLength(string_view s1, string_view s2){
+        return getCommonLengthKernels().prefix(s1.data(), s2.data(), min(s1.size(), s2.size()));
+    }
+
+    size_t commonSuffixLength(string_view s1, string_view s2){
+        return getCommonLengthKernels().suffix(s1.data() + s1.size(), s2.data() + s2.size(), min(s1.size(), s2.size()));
+    }
+
+    /*
+     * The bit-parallel edit distance of a longer sequence (len1) and a shorter one (len2 > 0), limited to limit operations (the lengths may differ by at most limit)
+     * The rows of the shorter sequence are packed into 64 bit words, so a column of the matrix costs one step per 64 elements instead of one per element
+     * getEqualities(j) returns the blocks of the element j of the longer sequence: bit i of block b is set if the element is at position 64 * b + i of the shorter sequence
+     * Returns limit + 1 if the distance is larger than limit
+     */
+    template<typename GetEqualities>
+    int bitParallelDistance(size_t len1, size_t len2, int limit, const GetEqualities& getEqualities){
+        const size_t blocks = (len2 + 63) / 64;
+
+        /*
+         * Ukkonen band: a cell on diagonal j - i has a distance of at least |j - i| to the start and of at least |len1 - len2 - (j - i)| to the end,
+         * so only the diagonals between -slack and len1 - len2 + slack can be part of an alignment with at most limit operations
+         * Only the blocks that intersect the band are computed, the cells outside of it are overestimated which does not change any distance up to the limit
+         */
+        const long long slack = (limit - (long long) (len1 - len2)) / 2;
+        const long long highestDiagonal = (long long) (len1 - len2) + slack;
+        auto rowsOfBlock = [&](size_t b){ return b + 1 == blocks ? len2 - 64 * b : 64; };
+
+        // the buffers are kept by each thread, so comparing a body with many others does not allocate them again (only the blocks up to lastBlock are used)
+        thread_local vector<uint64_t> positiveVertical;
+        thread_local vector<uint64_t> negativeVertical;
+        // distance in the last row of each block
+        thread_local vector<int> scores;
+        if(positiveVertical.size() < blocks){
+            positiveVertical.resize(blocks);
+            negativeVertical.resize(blocks);
+            scores.resize(blocks);
+        }
+        // the first column is 0, 1, 2, ... so every vertical difference is positive
+        positiveVertical[0] = ~uint64_t(0);
+        negativeVertical[0] = 0;
+        const unsigned lastBit = (len2 - 1) % 64;
+        size_t firstBlock = 0, lastBlock = 0;
+        scores[0] = rowsOfBlock(0);
+
+        for(size_t j = 1; j <= len1; ++j){
+            // the band moves down by one row per column, a new block starts as the (overestimated) continuation of the block above it
+            const size_t bandLastRow = min((long long) len2, (long long) j + slack);
+            while(lastBlock < (bandLastRow - 1) / 64){
+                lastBlock++;
+                positiveVertical[lastBlock] = ~uint64_t(0);
+                negativeVertical[lastBlock] = 0;
+                scores[lastBlock] = scores[lastBlock - 1] + rowsOfBlock(lastBlock);
+            }
+            const size_t bandFirstRow = max(1LL, (long long) j - highestDiagonal);
+            firstBlock = max(firstBlock, (bandFirstRow - 1) / 64);
+
+            const uint64_t* equal = getEqualities(j - 1);
+            // the first row is 0, 1, 2, ... so it grows by one in every column (above a later first block this is an overestimation)
+            int horizontal = 1;
+            bool withinLimit = false;
+            for(size_t b = firstBlock; b <= lastBlock; ++b){
+                uint64_t positiveHorizontal, negativeHorizontal;
+                calculateBlock(positiveVertical[b], negativeVertical[b], equal[b], horizontal, positiveHorizontal, negativeHorizontal);
+                // the rows after the end of the shorter sequence (in the last block) never influence the rows above them
+                const unsigned bit = b + 1 == blocks ? lastBit : 63;
+                horizontal = (int) ((positiveHorizontal >> bit) & 1) - (int) ((negativeHorizontal >> bit) & 1);
+                scores[b] += horizontal;
+                // the distances of neighbouring rows differ by at most one
+                if(scores[b] - (int) rowsOfBlock(b) + 1 <= limit){
+                    withinLimit = true;
+                }
+            }
+            // every alignment crosses the band in this column, so the limit is exceeded if all cells in it are above it
+            if(!withinLimit){
+                return limit + 1;
+            }
+        }
+        return min(scores[blocks - 1], limit + 1);
+    }
+
+    /*
+     * Byte-level version for the comparison of code, the characters are compared directly instead of converting each of them to a string
+     * Only returns the distance and needs O(min(n,m)) memory
+     * Distances above maxDistance are not computed, maxDistance + 1 is returned for them
+     */
+    int levenshteinDistance(string_view s1, string_view s2, int maxDistance){
+        // the common beginning and end of the strings do not change the distance, most bodies of renamed functions only differ in a small part
+        const size_t prefix = commonPrefixLength(s1, s2);
+        s1.remove_prefix(prefix);
+        s2.remove_prefix(prefix);
+        const size_t suffix = commonSuffixLength(s1, s2);
+        s1.remove_suffix(suffix);
+        s2.remove_suffix(suffix);
+
+        // the rows run over the shorter string
+        if(s2.size() > s1.size()){
+            swap(s1, s2);
+        }
+        const size_t len1 = s1.size(), len2 = s2.size();
+        // the distance is never larger than the longer string
+        const int limit = (int) min((size_t) max(maxDistance, 0), len1);
+        // every character that one string has more than the other costs at least one operation
+        if(len1 - len2 > (size_t) limit){
+            return limit + 1;
+        }
+        if(len2 == 0){
+            return len1;
+        }
+        const size_t blocks = (len2 + 63) / 64;
+
+        thread_local vector<uint64_t> equalities;
+        equalities.assign(256 * blocks, 0);
+        for(size_t i = 0; i < len2; ++i){
+            equalities[(unsigned char) s2[i] * blocks + i / 64] |= uint64_t(1) << (i % 64);
+        }
+        return bitParallelDistance(len1, len2, limit, [&](size_t j){ return &equalities[(unsigned char) s1[j] * blocks]; });
+    }
+
+    vector<string_view> tokenizeBody(const string& body){
+        static const clang::LangOptions langOptions = [](){
+            clang::LangOptions options;
+            options.CPlusPlus = true;
+            options.CPlusPlus11 = true;
+            options.CPlusPlus14 = true;
+            options.CPlusPlus17 = true;
+            // without it // is not a comment for the lexer, so //*** would start a block comment
+            options.LineComment = true;
+            return options;
+        }();
+        // the string is null terminated, which the lexer needs
+        clang::Lexer lexer(clang::SourceLocation(), langOptions, body.data(), body.data(), body.data() + body.size());
+        vector<string_view> tokens;
+        clang::Token token;
+        while(true){
+            lexer.LexFromRawLexer(token);
+            if(token.is(clang::tok::eof)){
+                break;
+            }
+            // the lexer stops directly behind the token
+            tokens.emplace_back(lexer.getBufferLocation() - token.getLength(), token.getLength());
+        }
+        return tokens;
+    }
 
-    double compareFunctionBodies(const functionanalysis::FunctionInstance& oldFunc, const functionanalysis::FunctionInstance& newFunc) {
-        auto strippedNewCode = helper::stripCodeOfEmptySpaces(helper::stripCodeOfComments(newFunc.body));
-        auto strippedOldCode = helper::stripCodeOfEmptySpaces(helper::stripCodeOfComments(oldFunc.body));
-        double distance = matcher::levenshteinDistance(convertStringToVector(strippedOldCode),
-                                                                        convertStringToVector(strippedNewCode))[strippedOldCode.length()][strippedNewCode.length()];
+    // the same for sequences of token ids (see TokenTable)
+    int levenshteinDistance(const vector<uint32_t>& tokens1, const vector<uint32_t>& tokens2, int maxDistance){
+        const uint32_t* s1 = tokens1.data();
+        const uint32_t* s2 = tokens2.data();
+        size_t len1 = tokens1.size(), len2 = tokens2.size();
+        // the common beginning and end of the sequences do not change the distance
+        while(len1 > 0 && len2 > 0 && *s1 == *s2){
+            s1++, s2++, len1--, len2--;
+        }
+        while(len1 > 0 && len2 > 0 && s1[len1 - 1] == s2[len2 - 1]){
+            len1--, len2--;
+        }
+
+        // the rows run over the shorter sequence
+        if(len2 > len1){
+            swap(s1, s2);
+            swap(len1, len2);
+        }
+        const int limit = (int) min((size_t) max(maxDistance, 0), len1);
+        if(len1 - len2 > (size_t) limit){
+            return limit + 1;
+        }
+        if(len2 == 0){
+            return len1;
+        }
+        const size_t blocks = (len2 + 63) / 64;
+
+        // the ids are global, so the tokens of the shorter sequence get local numbers (0 is for the tokens that are not part of it)
+        // the numbers are kept by each thread in a table indexed by the (dense, see TokenTable) ids and the entries of this call are reset at the end, so nothing is allocated per call
+        thread_local vector<uint32_t> localIds;
+        uint32_t localCount = 1;
+        for(size_t i = 0; i < len2; ++i){
+            if(s2[i] >= localIds.size()){
+                localIds.resize((size_t) s2[i] + 1, 0);
+            }
+            if(localIds[s2[i]] == 0){
+                localIds[s2[i]] = localCount++;
+            }
+        }
+        thread_local vector<uint64_t> equalities;
+        equalities.assign(localCount * blocks, 0);
+        for(size_t i = 0; i < len2; ++i){
+            equalities[localIds[s2[i]] * blocks + i / 64] |= uint64_t(1) << (i % 64);
+        }
+        const int distance = bitParallelDistance(len1, len2, limit, [&](size_t j){
+            return s1[j] < localIds.size() ? &equalities[localIds[s1[j]] * blocks] : &equalities[0];
+        });
+        for(size_t i = 0; i < len2; ++i){
+            localIds[s2[i]] = 0;
+        }
+        return distance;
+    }
+
+    /*
+     * Similarity of the bodies in percent (100 for identical bodies)
+     * Returns -1 if the similarity is below minimumSimilarity, in which case the distance is not computed completely
+     */
+    double compareFunctionBodies(const functionanalysis::FunctionInstance& oldFunc, const functionanalysis::FunctionInstance& newFunc, double minimumSimilarity) {
+        return compareStrippedBodies(helper::stripCodeOfEmptySpaces(helper::stripCodeOfComments(oldFunc.body)), helper::stripCodeOfEmptySpaces(helper::stripCodeOfComments(newFunc.body)), minimumSimilarity);
+    }
+
+    // the same for bodies that were already stripped of comments and empty spaces, so a body compared with many others is only stripped once
+    double compareStrippedBodies(string_view strippedOldCode, string_view strippedNewCode, double minimumSimilarity) {
         unsigned long longest = std::max(strippedOldCode.length(),strippedNewCode.length());
-        return (1-distance/longest) * 100;
+        // one more than needed, so the rounding of the bound never rejects a body that reaches the similarity
+        int maxDistance = (int) min((double) longest, (100 - minimumSimilarity) / 100 * longest + 1);
+        double distance = matcher::levenshteinDistance(strippedOldCode, strippedNewCode, maxDistance);
+        if(distance > maxDistance){
+            return -1;
+        }
+        double similarity = (1-distance/longest) * 100;
+        if(similarity < minimumSimilarity){
+            return -1;
+        }
+        return similarity;
+    }
+
+    // the same as compareFunctionBodies for the tokens of the bodies, so the similarity does not depend on the formatting or the length of the identifiers
+    double compareFunctionBodyTokens(const functionanalysis::FunctionInstance& oldFunc, const functionanalysis::FunctionInstance& newFunc, double minimumSimilarity) {
+        unsigned long longest = std::max(oldFunc.bodyTokens.size(), newFunc.bodyTokens.size());
+        int maxDistance = (int) min((double) longest, (100 - minimumSimilarity) / 100 * longest + 1);
+        double distance = matcher::levenshteinDistance(oldFunc.bodyTokens, newFunc.bodyTokens, maxDistance);
+        if(distance > maxDistance){
+            return -1;
+        }
+        double similarity = (1-distance/longest) * 100;
+        if(similarity < minimumSimilarity){
+            return -1;
+        }
+        return similarity;
+    }
+
+    // finalizer of splitmix64, spreads every bit of the input over the whole output
+    inline uint64_t mixHash(uint64_t value){
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    inline uint64_t rotateLeft(uint64_t value, int bits){
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    BodyIndex::BodyIndex(const vector<functionanalysis::FunctionInstance>& functions) : buckets(bands) {
+        signatures.resize(functions.size() * signatureLength);
+        indexed.resize(functions.size(), false);
+        for(int id = 0; id < (int) functions.size(); id++){
+            if(functions.at(id).isDeclaration){
+                continue;
+            }
+            auto signature = computeSignature(functions.at(id).body);
+            copy(signature.begin(), signature.end(), signatures.begin() + (size_t) id * signatureLength);
+            for(int band = 0; band < bands; band++){
+                buckets.at(band)[getBandKey(signature.data(), band)].push_back(id);
+            }
+            indexed.at(id) = true;
+        }
+    }
+
+    vector<int> BodyIndex::findCandidates(const functionanalysis::FunctionInstance& function, int count) const {
+        auto signature = computeSignature(function.body);
+        vector<int> candidates;
+        for(int band = 0; band < bands; band++){
+            auto found = buckets.at(band).find(getBandKey(signature.data(), band));
+            if(found == buckets.at(band).end()){
+                continue;
+            }
+            for (const auto &id: found->second){
+                if(indexed.at(id)){
+                    candidates.push_back(id);
+                }
+            }
+        }
+        sort(candidates.begin(), candidates.end());
+        candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+        if((int) candidates.size() > count){
+            // the share of equal values of two signatures estimates the similarity (Jaccard index) of the shingles of the bodies
+            vector<pair<int, int>> scored;
+            for (const auto &id: candidates){
+                const uint64_t* other = &signatures.at((size_t) id * signatureLength);
+                int equal = 0;
+                for(int i = 0; i < signatureLength; i++){
+                    equal += signature[i] == other[i];
+                }
+                scored.emplace_back(-equal, id);
+            }
+            partial_sort(scored.begin(), scored.begin() + count, scored.end());
+            candidates.clear();
+            for(int i = 0; i < count; i++){
+                candidates.push_back(scored.at(i).second);
+            }
+            sort(candidates.begin(), candidates.end());
+        }
+        return candidates;
+    }
+
+    void BodyIndex::remove(int id){
+        indexed.at(id) = false;
+    }
+
+    vector<uint64_t> BodyIndex::computeSignature(const string& body){
+        // tokens are identifiers, keywords and numbers or single other characters, so the spacing of the code does not matter
+        string code = helper::stripCodeOfComments(body);
+        vector<uint64_t> tokens;
+        size_t i = 0;
+        while(i < code.size()){
+            unsigned char character = code[i];
+            if(isspace(character)){
+                i++;
+                continue;
+            }
+            size_t start = i;
+            if(isalnum(character) || character == '_'){
+                while(i < code.size() && (isalnum((unsigned char) code[i]) || code[i] == '_')) i++;
+            }else{
+                i++;
+            }
+            tokens.push_back(llvm::xxHash64(llvm::StringRef(code.data() + start, i - start)));
+        }
+
+        vector<uint64_t> shingles;
+        for(size_t t = 0; t + 2 < tokens.size(); t++){
+            shingles.push_back(tokens[t] ^ rotateLeft(tokens[t + 1], 21) ^ rotateLeft(tokens[t + 2], 42));
+        }
+        // very short bodies are a single shingle
+        if(shingles.empty() && !tokens.empty()){
+            uint64_t shingle = 0;
+            for (const auto &token: tokens){
+                shingle = rotateLeft(shingle, 21) ^ token;
+            }
+            shingles.push_back(shingle);
+        }
+        sort(shingles.begin(), shingles.end());
+        shingles.erase(unique(shingles.begin(), shingles.end()), shingles.end());
+
+        // every value of the signature is the minimum of another hash function over all shingles
+        vector<uint64_t> signature(signatureLength, UINT64_MAX);
+        for (const auto &shingle: shingles){
+            for(int h = 0; h < signatureLength; h++){
+                signature[h] = min(signature[h], mixHash(shingle + 0x9e3779b97f4a7c15ULL * (h + 1)));
+            }
+        }
+        return signature;
+    }
+
+    uint64_t BodyIndex::getBandKey(const uint64_t* signature, int band){
+        uint64_t key = 0;
+        for(int row = 0; row < rowsPerBand; row++){
+            key = mixHash(key ^ signature[band * rowsPerBand + row]);
+        }
+        return key;
     }
 
     /*
@@ -60,7 +552,56 @@ namespace matcher{
         return output;
     }
 
-    vector<Operation> getOptimalParamConversion(vector<pair<string, pair<string, string>>> oldParamStructure, vector<pair<string, pair<string, string>>> newParamStructure){
+    /*
+     * Whether two params give the same token in paramsToFlatString, compared piece by piece instead of concatenating them
+     * (the pieces can split the same token differently, e.g. "unsigned int" "x" and "unsigned" "int x")
+     */
+    inline bool flatParamsEqual(const pair<string, pair<string, string>>& param1, const pair<string, pair<string, string>>& param2){
+        const string_view pieces1[] = {param1.first, " ", param1.second.first, param1.second.second.empty() ? "" : "=", param1.second.second};
+        const string_view pieces2[] = {param2.first, " ", param2.second.first, param2.second.second.empty() ? "" : "=", param2.second.second};
+        size_t length1 = 0, length2 = 0;
+        for(int i = 0; i < 5; i++){
+            length1 += pieces1[i].size();
+            length2 += pieces2[i].size();
+        }
+        if(length1 != length2){
+            return false;
+        }
+        int piece1 = 0, piece2 = 0;
+        size_t position1 = 0, position2 = 0;
+        for(size_t i = 0; i < length1; i++){
+            while(position1 == pieces1[piece1].size()){
+                piece1++;
+                position1 = 0;
+            }
+            while(position2 == pieces2[piece2].size()){
+                piece2++;
+                position2 = 0;
+            }
+            if(pieces1[piece1][position1++] != pieces2[piece2][position2++]){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool paramsDiffer(const vector<pair<string, pair<string, string>>>& params1, const vector<pair<string, pair<string, string>>>& params2){
+        if(params1.size() != params2.size()){
+            return true;
+        }
+        for(size_t i = 0; i < params1.size(); i++){
+            if(!flatParamsEqual(params1[i], params2[i])){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    vector<Operation> getOptimalParamConversion(const vector<pair<string, pair<string, string>>>& oldParamStructure, const vector<pair<string, pair<string, string>>>& newParamStructure){
+        // equal params (the usual case when comparing headers) need no conversion, so nothing is allocated for them
+        if(oldParamStructure == newParamStructure){
+            return {};
+        }
         vector<string> oldParams = paramsToFlatString(oldParamStructure);
         vector<string> newParams = paramsToFlatString(newParamStructure);
 
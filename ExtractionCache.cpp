@@ -0,0 +1,343 @@
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+#include <llvm/ADT/StringExtras.h>
+#include "include/json.hpp"
+#include "header/HelperFunctions.h"
+#include "header/ExtractionState.h"
+#include "header/FilePosition.h"
+
+using json = nlohmann::json;
+using namespace functionanalysis;
+using namespace variableanalysis;
+using namespace objectanalysis;
+
+namespace extraction {
+
+    /*
+     * Keeps the extracted findings of every translation unit on disk, so unchanged translation units do not have to be parsed again in later runs
+     * An entry is found through the main file, the compile command and the directory of the project and is only used if the content of every file
+     * that was part of the translation unit (and whether it belongs to the project) is still the same
+     * There is one cache per version, since the project files and the file ids differ between the versions
+     */
+    class ExtractionCache {
+    public:
+        // increase if the extracted instances change, so old entries are not used anymore
+        static constexpr int formatVersion = 2;
+
+        ExtractionCache(std::string cacheDirectory, std::string directory, const std::unordered_set<std::string>* projectFiles){
+            this->cacheDirectory = cacheDirectory;
+            this->directory = directory;
+            this->projectFiles = projectFiles;
+            llvm::sys::fs::create_directories(cacheDirectory);
+        }
+
+        // loads the entry of the translation unit into the buffer, returns false if there is no valid entry
+        bool load(const std::string& file, const std::string& command, FileTable* fileTable, TranslationUnitBuffer* buffer){
+            std::ifstream input(getEntryPath(file, command));
+            if(!input.is_open()){
+                return false;
+            }
+            json entry = json::parse(input, nullptr, false);
+            if(entry.is_discarded()){
+                return false;
+            }
+            // an entry with missing or wrong values (e.g. written by another version or changed by hand) is treated like a missing one,
+            // so the findings are read into local vectors and only added to the buffer if the whole entry is valid
+            std::vector<FunctionInstance> functions;
+            std::vector<TranslationUnitBuffer::FunctionRecord> functionRecords;
+            std::vector<VariableInstance> variables;
+            std::vector<ObjectInstance> objects;
+            try{
+                if(!entry.is_object() || entry.value("formatVersion", -1) != formatVersion || entry.value("file", "") != file || entry.value("command", "") != command){
+                    return false;
+                }
+                for (const auto &item: entry.at("includedFiles")){
+                    auto state = getFileState(item.at("path").get<std::string>());
+                    if(!state.readable || state.hash != item.at("hash").get<uint64_t>() || state.isProjectFile != item.at("isProjectFile").get<bool>()){
+                        return false;
+                    }
+                }
+
+                for (const auto &item: entry.at("functions")){
+                    functions.push_back(functionFromJson(item, fileTable));
+                }
+                for (const auto &item: entry.at("functionRecords")){
+                    TranslationUnitBuffer::FunctionRecord record;
+                    int kind = item.at("kind").get<int>();
+                    if(kind < TranslationUnitBuffer::FunctionRecord::DEFINITION || kind > TranslationUnitBuffer::FunctionRecord::DEFINED_DECLARATION){
+                        return false;
+                    }
+                    record.kind = (TranslationUnitBuffer::FunctionRecord::Kinds) kind;
+                    record.instance = item.at("instance").get<int>();
+                    record.definition = item.at("definition").get<int>();
+                    // the records are replayed with the indices into the functions of the entry
+                    if(record.instance < 0 || record.instance >= functions.size()){
+                        return false;
+                    }
+                    if(record.kind == TranslationUnitBuffer::FunctionRecord::DEFINED_DECLARATION && (record.definition < 0 || record.definition >= functions.size())){
+                        return false;
+                    }
+                    record.definitionPosition = positionFromJson(item.at("definitionPosition"), fileTable);
+                    record.definitionFilenameEmpty = item.at("definitionFilenameEmpty").get<bool>();
+                    functionRecords.push_back(record);
+                }
+                for (const auto &item: entry.at("variables")){
+                    variables.push_back(variableFromJson(item, fileTable));
+                }
+                for (const auto &item: entry.at("objects")){
+                    objects.push_back(objectFromJson(item, fileTable));
+                }
+            }catch(const json::exception&){
+                return false;
+            }catch(const std::out_of_range&){
+                return false;
+            }
+
+            buffer->functions = std::move(functions);
+            buffer->functionRecords = std::move(functionRecords);
+            buffer->variables = std::move(variables);
+            buffer->objects = std::move(objects);
+            return true;
+        }
+
+        // writes the buffer of a translation unit as the entry of the main file (the included files also contain the main file)
+        void store(const std::string& file, const std::string& command, const std::vector<std::string>& includedFiles, const FileTable& fileTable, const TranslationUnitBuffer& buffer){
+            json entry;
+            entry["formatVersion"] = formatVersion;
+            entry["file"] = file;
+            entry["command"] = command;
+            entry["includedFiles"] = json::array();
+            for (const auto &item: includedFiles){
+                auto state = getFileState(item);
+                // the entry could never be valid again
+                if(!state.readable){
+                    return;
+                }
+                entry["includedFiles"].push_back({{"path", item}, {"hash", state.hash}, {"isProjectFile", state.isProjectFile}});
+            }
+
+            entry["functions"] = json::array();
+            for (const auto &item: buffer.functions){
+                entry["functions"].push_back(functionToJson(item, fileTable));
+            }
+            entry["functionRecords"] = json::array();
+            for (const auto &item: buffer.functionRecords){
+                entry["functionRecords"].push_back({{"kind", (int) item.kind}, {"instance", item.instance}, {"definition", item.definition},
+                                                    {"definitionPosition", positionToJson(item.definitionPosition, fileTable)}, {"definitionFilenameEmpty", item.definitionFilenameEmpty}});
+            }
+            entry["variables"] = json::array();
+            for (const auto &item: buffer.variables){
+                entry["variables"].push_back(variableToJson(item, fileTable));
+            }
+            entry["objects"] = json::array();
+            for (const auto &item: buffer.objects){
+                entry["objects"].push_back(objectToJson(item, fileTable));
+            }
+
+            // the entry is written to a temporary file first, so a parallel or an aborted run never sees half of an entry
+            int fd;
+            llvm::SmallString<256> temporaryPath;
+            if(llvm::sys::fs::createUniqueFile(cacheDirectory + "/entry-%%%%%%%%.tmp", fd, temporaryPath)){
+                return;
+            }
+            {
+                llvm::raw_fd_ostream output(fd, true);
+                output << entry.dump();
+            }
+            if(llvm::sys::fs::rename(temporaryPath, getEntryPath(file, command))){
+                llvm::sys::fs::remove(temporaryPath);
+            }
+        }
+
+    private:
+        std::string cacheDirectory;
+        std::string directory;
+        const std::unordered_set<std::string>* projectFiles;
+
+        struct FileState {
+            bool readable;
+            uint64_t hash;
+            bool isProjectFile;
+        };
+        // the same headers are part of most translation units, so every file is only hashed once per run
+        std::unordered_map<std::string, FileState> fileStates;
+        std::mutex fileStatesMutex;
+
+        FileState getFileState(const std::string& path){
+            {
+                std::lock_guard<std::mutex> lock(fileStatesMutex);
+                auto found = fileStates.find(path);
+                if(found != fileStates.end()){
+                    return found->second;
+                }
+            }
+            FileState state;
+            state.hash = 0;
+            state.readable = helper::hashFile(path, &state.hash);
+            state.isProjectFile = state.readable && projectFiles->count(std::filesystem::weakly_canonical(path).string()) != 0;
+            std::lock_guard<std::mutex> lock(fileStatesMutex);
+            fileStates.insert(std::make_pair(path, state));
+            return state;
+        }
+
+        std::string getEntryPath(const std::string& file, const std::string& command) const {
+            std::string key = std::to_string(formatVersion) + "\n" + directory + "\n" + file + "\n" + command;
+            return cacheDirectory + "/" + llvm::utohexstr(llvm::xxHash64(key)) + ".json";
+        }
+
+        // the file ids are only valid during a single run, so the positions are stored with their filenames
+        static json positionToJson(const FilePosition& position, const FileTable& fileTable){
+            if(position.file == -1){
+                return json();
+            }
+            return {{"filename", fileTable.getFilename(position.file)}, {"line", position.line}, {"column", position.column}, {"unresolved", position.unresolved}};
+        }
+
+        static FilePosition positionFromJson(const json& value, FileTable* fileTable){
+            FilePosition position;
+            if(value.is_null()){
+                return position;
+            }
+            position.file = fileTable->getId(value.at("filename").get<std::string>());
+            position.line = value.at("line").get<unsigned>();
+            position.column = value.at("column").get<unsigned>();
+            position.unresolved = value.at("unresolved").get<bool>();
+            return position;
+        }
+
+        static json functionToJson(const FunctionInstance& function, const FileTable& fileTable){
+            json value;
+            value["isDeclaration"] = function.isDeclaration;
+            value["name"] = function.name;
+            value["qualifiedName"] = function.qualifiedName;
+            value["returnType"] = function.returnType;
+            value["params"] = function.params;
+            value["body"] = function.body;
+            value["bodyHash"] = function.bodyHash;
+            value["location"] = function.location;
+            value["filePosition"] = positionToJson(function.filePosition, fileTable);
+            value["declarations"] = json::array();
+            for (const auto &item: function.declarations){
+                value["declarations"].push_back(functionToJson(item, fileTable));
+            }
+            value["filename"] = function.filename;
+            value["scope"] = function.scope;
+            value["storageClass"] = function.storageClass;
+            value["memberFunctionSpecifier"] = function.memberFunctionSpecifier;
+            value["fullHeader"] = function.fullHeader;
+            value["isConst"] = function.isConst;
+            value["isTemplateDecl"] = function.isTemplateDecl;
+            value["isTemplateSpec"] = function.isTemplateSpec;
+            value["templateSpecializations"] = json::array();
+            for (const auto &item: function.templateSpecializations){
+                value["templateSpecializations"].push_back(functionToJson(item, fileTable));
+            }
+            value["templateParams"] = function.templateParams;
+            return value;
+        }
+
+        static FunctionInstance functionFromJson(const json& value, FileTable* fileTable){
+            FunctionInstance function;
+            function.isDeclaration = value.at("isDeclaration").get<bool>();
+            function.name = value.at("name").get<std::string>();
+            function.qualifiedName = value.at("qualifiedName").get<std::string>();
+            function.returnType = value.at("returnType").get<std::string>();
+            value.at("params").get_to(function.params);
+            function.body = value.at("body").get<std::string>();
+            function.bodyHash = value.at("bodyHash").get<uint64_t>();
+            value.at("location").get_to(function.location);
+            function.filePosition = positionFromJson(value.at("filePosition"), fileTable);
+            for (const auto &item: value.at("declarations")){
+                function.declarations.push_back(functionFromJson(item, fileTable));
+            }
+            function.filename = value.at("filename").get<std::string>();
+            function.scope = value.at("scope").get<std::string>();
+            function.storageClass = value.at("storageClass").get<std::string>();
+            function.memberFunctionSpecifier = value.at("memberFunctionSpecifier").get<std::string>();
+            function.fullHeader = value.at("fullHeader").get<std::string>();
+            function.isConst = value.at("isConst").get<bool>();
+            function.isTemplateDecl = value.at("isTemplateDecl").get<bool>();
+            function.isTemplateSpec = value.at("isTemplateSpec").get<bool>();
+            for (const auto &item: value.at("templateSpecializations")){
+                function.templateSpecializations.push_back(functionFromJson(item, fileTable));
+            }
+            value.at("templateParams").get_to(function.templateParams);
+            return function;
+        }
+
+        static json variableToJson(const VariableInstance& variable, const FileTable& fileTable){
+            json value;
+            value["isClassMember"] = variable.isClassMember;
+            value["name"] = variable.name;
+            value["qualifiedName"] = variable.qualifiedName;
+            value["type"] = variable.type;
+            value["location"] = variable.location;
+            value["filename"] = variable.filename;
+            value["filePosition"] = positionToJson(variable.filePosition, fileTable);
+            value["storageClass"] = variable.storageClass;
+            value["isInline"] = variable.isInline;
+            value["accessSpecifier"] = variable.accessSpecifier;
+            value["isConst"] = variable.isConst;
+            value["qualifiers"] = variable.qualifiers;
+            value["isExplicit"] = variable.isExplicit;
+            value["isVolatile"] = variable.isVolatile;
+            value["isMutable"] = variable.isMutable;
+            return value;
+        }
+
+        static VariableInstance variableFromJson(const json& value, FileTable* fileTable){
+            VariableInstance variable;
+            variable.isClassMember = value.at("isClassMember").get<bool>();
+            variable.name = value.at("name").get<std::string>();
+            variable.qualifiedName = value.at("qualifiedName").get<std::string>();
+            variable.type = value.at("type").get<std::string>();
+            value.at("location").get_to(variable.location);
+            variable.filename = value.at("filename").get<std::string>();
+            variable.filePosition = positionFromJson(value.at("filePosition"), fileTable);
+            variable.storageClass = value.at("storageClass").get<std::string>();
+            variable.isInline = value.at("isInline").get<bool>();
+            variable.accessSpecifier = value.at("accessSpecifier").get<std::string>();
+            variable.isConst = value.at("isConst").get<bool>();
+            variable.qualifiers = value.at("qualifiers").get<std::string>();
+            variable.isExplicit = value.at("isExplicit").get<bool>();
+            variable.isVolatile = value.at("isVolatile").get<bool>();
+            variable.isMutable = value.at("isMutable").get<bool>();
+            return variable;
+        }
+
+        static json objectToJson(const ObjectInstance& object, const FileTable& fileTable){
+            json value;
+            value["objectType"] = (int) object.objectType;
+            value["name"] = object.name;
+            value["qualifiedName"] = object.qualifiedName;
+            value["location"] = object.location;
+            value["filename"] = object.filename;
+            value["filePosition"] = positionToJson(object.filePosition, fileTable);
+            value["isAbstract"] = object.isAbstract;
+            value["isFinal"] = object.isFinal;
+            return value;
+        }
+
+        static ObjectInstance objectFromJson(const json& value, FileTable* fileTable){
+            ObjectInstance object;
+            object.objectType = (clang::TagTypeKind) value.at("objectType").get<int>();
+            object.name = value.at("name").get<std::string>();
+            object.qualifiedName = value.at("qualifiedName").get<std::string>();
+            value.at("location").get_to(object.location);
+            object.filename = value.at("filename").get<std::string>();
+            object.filePosition = positionFromJson(value.at("filePosition"), fileTable);
+            object.isAbstract = value.at("isAbstract").get<bool>();
+            object.isFinal = value.at("isFinal").get<bool>();
+            return object;
+        }
+    };
+}
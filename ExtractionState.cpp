@@ -0,0 +1,163 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include "header/ExtractionState.h"
+#include "header/FilePosition.h"
+
+using namespace functionanalysis;
+using namespace variableanalysis;
+using namespace objectanalysis;
+
+namespace extraction {
+
+    /*
+     * The extracted functions, variables and objects of one version of the project
+     * Instances found in multiple translation units (e.g. through headers) are only added once, the first occurrence is kept
+     * The vectors are indexed by the file position of their entries, so they may only be extended through the add functions
+     */
+    class ExtractionState : public ExtractionSink {
+    public:
+        std::vector<FunctionInstance> program;
+        std::vector<VariableInstance> variables;
+        std::vector<ObjectInstance> objects;
+        // declarations without a (found) definition
+        std::unordered_map<FilePosition, FunctionInstance, FilePositionHash> mapOfDeclarations;
+        std::map<std::string, VariableInstance> variableDefinitions;
+        // the filenames of the file positions of this version
+        FileTable fileTable;
+
+        void addFunctionDefinition(const FilePosition& position, const FunctionFactory& create) override {
+            if(findFunctionInstance(position) == -1){
+                appendFunction(create());
+            }
+        }
+
+        void addFunctionDeclaration(const FilePosition& position, const FunctionFactory& create) override {
+            if(mapOfDeclarations.find(position) != mapOfDeclarations.end()){
+                return;
+            }
+            mapOfDeclarations.insert(std::make_pair(position, create()));
+        }
+
+        void addDefinedFunctionDeclaration(const FilePosition& position, const FunctionFactory& create, const FilePosition& definitionPosition, bool definitionFilenameEmpty, const FunctionFactory& createDefinition) override {
+            auto index = findFunctionInstance(definitionPosition);
+            if(index != -1){
+                if(declarationPositions.at(index).count(position)){
+                    return;
+                }
+                appendDeclaration(index, getDeclaration(position, create));
+                return;
+            }
+
+            FunctionInstance functionInstance = getDeclaration(position, create);
+
+            // some definition filenames are empty (about 7 out of 11000 and no idea why), so the filename is set to the declaration filename
+            FunctionInstance definition;
+            if(definitionFilenameEmpty){
+                auto filePosition = definitionPosition;
+                filePosition.file = position.file;
+                filePosition.unresolved = true;
+                if(findFunctionInstance(filePosition) != -1){
+                    return;
+                }
+                definition = createDefinition();
+                definition.filename = functionInstance.filename;
+                definition.filePosition = filePosition;
+                definition.declarations[0].filename = definition.filename;
+                definition.declarations[0].filePosition = definition.filePosition;
+            }else{
+                definition = createDefinition();
+            }
+            definition.declarations.push_back(functionInstance.getDeclarationEntry());
+            appendFunction(std::move(definition));
+        }
+
+        void addVariable(const FilePosition& position, const VariableFactory& create) override {
+            if(findVariableInstance(position) != -1){
+                return;
+            }
+            variablePositions.insert(std::make_pair(position, variables.size()));
+            variables.push_back(create());
+        }
+
+        void addObject(const FilePosition& position, const ObjectFactory& create) override {
+            if(findObjectInstance(position) != -1){
+                return;
+            }
+            objectPositions.insert(std::make_pair(position, objects.size()));
+            objects.push_back(create());
+        }
+
+        // merges the findings of a translation unit, which results in the same state as if the translation unit was extracted directly into this state
+        void replay(const TranslationUnitBuffer& buffer){
+            for (const auto &record: buffer.functionRecords){
+                const auto& instance = buffer.functions.at(record.instance);
+                auto create = [&instance](){ return instance; };
+                if(record.kind == TranslationUnitBuffer::FunctionRecord::DEFINITION){
+                    addFunctionDefinition(instance.filePosition, create);
+                }else if(record.kind == TranslationUnitBuffer::FunctionRecord::DECLARATION){
+                    addFunctionDeclaration(instance.filePosition, create);
+                }else{
+                    const auto& definition = buffer.functions.at(record.definition);
+                    addDefinedFunctionDeclaration(instance.filePosition, create, record.definitionPosition, record.definitionFilenameEmpty, [&definition](){ return definition; });
+                }
+            }
+            for (const auto &item: buffer.variables){
+                addVariable(item.filePosition, [&item](){ return item; });
+            }
+            for (const auto &item: buffer.objects){
+                addObject(item.filePosition, [&item](){ return item; });
+            }
+        }
+
+    private:
+        FunctionInstance getDeclaration(const FilePosition& position, const FunctionFactory& create){
+            auto found = mapOfDeclarations.find(position);
+            if(found != mapOfDeclarations.end()){
+                return found->second;
+            }
+            auto functionInstance = create();
+            mapOfDeclarations.insert(std::make_pair(position, functionInstance));
+            return functionInstance;
+        }
+
+        // file position -> index in the vectors
+        std::unordered_map<FilePosition, int, FilePositionHash> functionPositions;
+        std::unordered_map<FilePosition, int, FilePositionHash> variablePositions;
+        std::unordered_map<FilePosition, int, FilePositionHash> objectPositions;
+        // file positions of the declarations of each function in the program
+        std::vector<std::unordered_set<FilePosition, FilePositionHash>> declarationPositions;
+
+        void appendFunction(FunctionInstance functionInstance){
+            functionPositions.insert(std::make_pair(functionInstance.filePosition, program.size()));
+            std::unordered_set<FilePosition, FilePositionHash> positions;
+            for (const auto &item: functionInstance.declarations){
+                positions.insert(item.filePosition);
+            }
+            declarationPositions.push_back(std::move(positions));
+            program.push_back(std::move(functionInstance));
+        }
+
+        void appendDeclaration(int index, const FunctionInstance& declaration){
+            declarationPositions.at(index).insert(declaration.filePosition);
+            program.at(index).declarations.push_back(declaration.getDeclarationEntry());
+        }
+
+        int findFunctionInstance(const FilePosition& filePos) const {
+            auto found = functionPositions.find(filePos);
+            return found == functionPositions.end() ? -1 : found->second;
+        }
+
+        int findVariableInstance(const FilePosition& filePos) const {
+            auto found = variablePositions.find(filePos);
+            return found == variablePositions.end() ? -1 : found->second;
+        }
+
+        int findObjectInstance(const FilePosition& filePos) const {
+            auto found = objectPositions.find(filePos);
+            return found == objectPositions.end() ? -1 : found->second;
+        }
+    };
+}
@@ -4,6 +4,12 @@
 #include "header/HelperFunctions.h"
 #include "header/OutputHandler.h"
 #include <vector>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+#include <cmath>
+#include <algorithm>
 #include "omp.h"
 
 using namespace llvm;
@@ -12,50 +18,117 @@ using namespace std;
 
 namespace functionanalysis{
 
+    // a candidate for a renamed function (index in the newProgram and similarity of the bodies)
+    struct BodyMatch {
+        int index;
+        double score;
+    };
+
+    // the more similar body wins and of equally similar bodies the first one, which is the choice of the serial search
+    inline BodyMatch getBetterBodyMatch(const BodyMatch& first, const BodyMatch& second){
+        if(first.index == -1) return second;
+        if(second.index == -1) return first;
+        if(first.score != second.score) return first.score > second.score ? first : second;
+        return first.index < second.index ? first : second;
+    }
+
+    // how an old function was matched to the newProgram
+    enum class MatchKind { SKIPPED, SAME, OVERLOADED, RENAMED, DELETED };
+
+    // an entry of the match table, that is built before anything is reported (newIndex and score are -1 if there is no new function)
+    struct FunctionMatch {
+        int oldIndex = -1;
+        int newIndex = -1;
+        MatchKind kind = MatchKind::SKIPPED;
+        double score = -1;
+    };
+
+    // the functions of a program by their position (qualified name and file) and by their name, the indices are sorted
+    class FunctionIndex {
+    public:
+        FunctionIndex() = default;
+
+        explicit FunctionIndex(const std::vector<FunctionInstance>& set){
+            for(int i=0;i<set.size();i++){
+                byPosition[getPositionKey(set.at(i).qualifiedName, set.at(i).filename)].push_back(i);
+                byName[set.at(i).name].push_back(i);
+            }
+        }
+
+        const std::vector<int>* findByPosition(const std::string& qualifiedName, const std::string& filename) const {
+            auto found = byPosition.find(getPositionKey(qualifiedName, filename));
+            return found == byPosition.end() ? nullptr : &found->second;
+        }
+
+        const std::vector<int>* findByName(const std::string& name) const {
+            auto found = byName.find(name);
+            return found == byName.end() ? nullptr : &found->second;
+        }
+
+        static std::string getPositionKey(const std::string& qualifiedName, const std::string& filename){
+            return qualifiedName + '\0' + filename;
+        }
+
+    private:
+        std::unordered_map<std::string, std::vector<int>> byPosition;
+        std::unordered_map<std::string, std::vector<int>> byName;
+    };
+
     class FunctionAnalyser {
         std::vector<FunctionInstance> oldProgram;
         std::vector<FunctionInstance> newProgram;
         OutputHandler* outputHandler;
         std::vector<std::vector<FunctionInstance>> newOverloadedFunctions;
         int counter = 0;
+        // threads used to score the candidates of renamed functions
+        int jobs = 1;
 
         const double percentageCutOff = 90;
 
+        // only set if the candidates of renamed functions are taken from the index (--doc with --rename-candidates)
+        std::unique_ptr<matcher::BodyIndex> bodyIndex;
+        int renameCandidates = 0;
+        // the bodies are compared by their tokens (see matcher::compareFunctionBodyTokens)
+        bool tokenSimilarity = false;
+        // functions of the newProgram that were already matched by a body (instead of erasing them, so the indices stay the same)
+        std::vector<char> consumed;
+        // the bodies of the definitions in newProgram without comments and empty spaces (not set for the token based comparison)
+        std::vector<std::string> strippedNewBodies;
+        // normalized body -> indices of the definitions in newProgram with it (sorted), only used without --doc
+        std::unordered_map<uint64_t, std::vector<int>> newBodyHashes;
+        FunctionIndex oldIndex;
+        FunctionIndex newIndex;
+        // name + position key (see FunctionIndex::getPositionKey) of the functions in newOverloadedFunctions, keyed by the name of their set
+        std::unordered_set<std::string> newOverloadedPositions;
+
         static bool isFunctionOverloaded(const FunctionInstance& oldFunc, const FunctionInstance& newFunc){
             // overloaded Functions have to have the same qualified name (i.e. be in the same namespace) and share at least one declaration position (definitions don´t have to be in the same file) : if one of the declarations is empty, the definition is the declaration
             return oldFunc.qualifiedName == newFunc.qualifiedName && checkIfADeclarationMatches(oldFunc, newFunc);
         }
 
-        int findFunction(const std::vector<FunctionInstance>& set, const FunctionInstance& oldFunc){
-            int tempSafe = -1;
-            for(int i=0;i<set.size();i++){
-                if(set.at(i).qualifiedName == oldFunc.qualifiedName && set.at(i).filename == oldFunc.filename){
-                    // prefer definitions to declarations if one is found
-                    if(oldFunc.isDeclaration && set.at(i).isDeclaration){
-                        //return i;
-                    }
-                    //if(!set.at(i).isDeclaration){
-                        return i;
-                    //}else{
-                        tempSafe = i;
-                    //}
-                }else{
-                    tempSafe = checkIfADeclarationMatches(set.at(i), oldFunc) && oldFunc.name == set.at(i).name ? i : tempSafe;
+        /*
+         * the first function at the same position (qualified name and file), -2 if the function is newly overloaded,
+         * otherwise the last function with the same name that shares a declaration file with it (-1 if there is none)
+         */
+        int findFunction(const std::vector<FunctionInstance>& set, const FunctionIndex& index, const FunctionInstance& oldFunc, const std::vector<char>* skipped = nullptr){
+            if(auto found = index.findByPosition(oldFunc.qualifiedName, oldFunc.filename)){
+                for (const auto &i: *found){
+                    if(!skipped || !skipped->at(i)) return i;
                 }
             }
 
-            for(auto& overloadedSet : newOverloadedFunctions){
-                if(overloadedSet.at(0).name != oldFunc.name) continue;
-                for(auto& func : overloadedSet){
-                    if(func.qualifiedName == oldFunc.qualifiedName && func.filename == oldFunc.filename){
-                        // signals that the searched function is now overloaded
-                        // TODO: add disclaimer
-                        return -2;
-                    }
-                }
+            // signals that the searched function is now overloaded
+            // TODO: add disclaimer
+            if(newOverloadedPositions.count(oldFunc.name + '\0' + FunctionIndex::getPositionKey(oldFunc.qualifiedName, oldFunc.filename))){
+                return -2;
             }
 
-            return tempSafe;
+            if(auto found = index.findByName(oldFunc.name)){
+                for (auto i = found->rbegin(); i != found->rend(); i++){
+                    if((!skipped || !skipped->at(*i)) && checkIfADeclarationMatches(set.at(*i), oldFunc)) return *i;
+                }
+            }
+            return -1;
         }
 
         pair<int,int> countFunctions(const std::vector<FunctionInstance>& set, const FunctionInstance& func){
@@ -93,176 +166,364 @@ namespace functionanalysis{
             return false;
         }
 
+        /*
+         * overloaded functions share their qualified name, so only the functions in the same bucket of qualified names are compared
+         * the functions of a bucket are grouped in the same way (and the groups are in the same order) as if every function was compared with every other one
+         */
         static std::vector<std::vector<FunctionInstance>> separateOverloadedFunctions(std::vector<FunctionInstance>& set){
-            std::vector<std::vector<FunctionInstance>> result;
-            int i=0;
-            while (i < set.size()){
-                std::vector<FunctionInstance> overloadedFunctionInstances;
-                int j=0;
-                while (j < set.size()){
-                    if(i == j) {
-                        j++;
-                        continue;
-                    }
+            std::unordered_map<std::string, std::vector<int>> buckets;
+            for(int i=0;i<set.size();i++){
+                buckets[set.at(i).qualifiedName].push_back(i);
+            }
 
-                    if(isFunctionOverloaded(set.at(i), set.at(j))){
-                        overloadedFunctionInstances.push_back(set.at(j));
-                        set.erase(set.begin()+j);
-                    }else{
-                        j++;
+            // index of the function the group was found with -> group
+            std::vector<std::pair<int, std::vector<int>>> groups;
+            std::vector<char> grouped(set.size(), false);
+            for(auto& bucket : buckets){
+                std::vector<int>& remaining = bucket.second;
+                if(remaining.size() < 2) continue;
+                int i=0;
+                while (i < remaining.size()){
+                    std::vector<int> overloadedFunctionInstances;
+                    int j=0;
+                    while (j < remaining.size()){
+                        if(i == j) {
+                            j++;
+                            continue;
+                        }
+
+                        if(isFunctionOverloaded(set.at(remaining.at(i)), set.at(remaining.at(j)))){
+                            overloadedFunctionInstances.push_back(remaining.at(j));
+                            remaining.erase(remaining.begin()+j);
+                            if(j < i) i--;
+                        }else{
+                            j++;
+                        }
+                    }
+                    if(!overloadedFunctionInstances.empty()){
+                        overloadedFunctionInstances.push_back(remaining.at(i));
+                        groups.emplace_back(remaining.at(i), overloadedFunctionInstances);
+                        remaining.erase(remaining.begin()+i);
+                    }else {
+                        i++;
                     }
                 }
-                if(!overloadedFunctionInstances.empty()){
-                    overloadedFunctionInstances.push_back(set.at(i));
-                    set.erase(set.begin()+i);
-                    result.push_back(overloadedFunctionInstances);
-                }else {
-                    i++;
+            }
+            std::sort(groups.begin(), groups.end(), [](const auto& first, const auto& second){ return first.first < second.first; });
+
+            std::vector<std::vector<FunctionInstance>> result;
+            result.reserve(groups.size());
+            for (const auto &group: groups){
+                std::vector<FunctionInstance> overloadedFunctionInstances;
+                for (const auto &index: group.second){
+                    overloadedFunctionInstances.push_back(std::move(set.at(index)));
+                    grouped.at(index) = true;
                 }
+                result.push_back(std::move(overloadedFunctionInstances));
             }
+            // the functions that are left keep their order
+            int kept = 0;
+            for(int i=0;i<set.size();i++){
+                if(!grouped.at(i)){
+                    if(kept != i) set.at(kept) = std::move(set.at(i));
+                    kept++;
+                }
+            }
+            set.resize(kept);
             outs() << "Found " << result.size() << " overloaded functions\n";
             outs() << set.size() << " non overloaded funcs left\n";
             return result;
         }
 
-        FunctionAnalyser(const std::vector<FunctionInstance>& oldProgram,
-                         const std::vector<FunctionInstance>& newProgram,
-                         OutputHandler* outputHandler) {
-            this->oldProgram = oldProgram;
-            this->newProgram = newProgram;
+        FunctionAnalyser(std::vector<FunctionInstance> oldProgram,
+                         std::vector<FunctionInstance> newProgram,
+                         OutputHandler* outputHandler, int jobs = 1) {
+            this->oldProgram = std::move(oldProgram);
+            this->newProgram = std::move(newProgram);
             this->outputHandler = outputHandler;
+            this->jobs = std::max(1, jobs);
         }
 
-        void compareVersionsWithDoc(bool docEnabled, bool includePrivate) {
+        void compareVersionsWithDoc(bool docEnabled, bool includePrivate, int renameCandidates = 0, bool tokenSimilarity = false) {
+            this->tokenSimilarity = tokenSimilarity;
 
             auto overloadedFunctions = separateOverloadedFunctions(oldProgram);
             newOverloadedFunctions = separateOverloadedFunctions(newProgram);
 
+            oldIndex = FunctionIndex(oldProgram);
+            newIndex = FunctionIndex(newProgram);
+            for(auto& overloadedSet : newOverloadedFunctions){
+                for(auto& func : overloadedSet){
+                    newOverloadedPositions.insert(overloadedSet.at(0).name + '\0' + FunctionIndex::getPositionKey(func.qualifiedName, func.filename));
+                }
+            }
+            consumed.assign(newProgram.size(), false);
+            if(!docEnabled || !tokenSimilarity){
+                strippedNewBodies.assign(newProgram.size(), "");
+                #pragma omp parallel for schedule(dynamic, 64) num_threads(jobs)
+                for(int i = 0; i < newProgram.size(); i++){
+                    if(!newProgram.at(i).isDeclaration){
+                        strippedNewBodies.at(i) = helper::stripCodeOfEmptySpaces(helper::stripCodeOfComments(newProgram.at(i).body));
+                    }
+                }
+            }
+            if(docEnabled && renameCandidates > 0){
+                this->renameCandidates = renameCandidates;
+                bodyIndex = std::make_unique<matcher::BodyIndex>(newProgram);
+            }
+            if(!docEnabled){
+                for(int i = 0; i < newProgram.size(); i++){
+                    if(!newProgram.at(i).isDeclaration){
+                        newBodyHashes[newProgram.at(i).bodyHash].push_back(i);
+                    }
+                }
+            }
+
             outs()<<"there are " << overloadedFunctions.size() << " overloaded functions\n";
             outs()<<"there are " << newOverloadedFunctions.size() << " new overloaded functions\n";
 
-            //omp_set_num_threads(10);
-            //for (auto const &func: oldProgram) {
-            //#pragma omp parallel for default(none) shared(docEnabled, includePrivate, counter, outputHandler) private(oldProgram, newProgram)
+            /*
+             * matching: every old function is matched in parallel against all new functions, as if no new function was consumed by a renaming yet
+             * afterwards the matches are checked in the order of the old functions and a match is only redone if a function it depends on was consumed before it,
+             * so the table is the same as if the functions were matched one after another
+             */
+            std::vector<FunctionMatch> matches(oldProgram.size());
+            std::vector<std::vector<int>> usedCandidates(oldProgram.size());
+            #pragma omp parallel for schedule(dynamic) num_threads(jobs)
             for(int i=0;i<oldProgram.size();i++) {
-
-                counter++;
-                if(counter % 2000 == 0){
-                    outs() << "Analysed " << counter << " functions\n";
+                matches.at(i) = matchFunction(i, docEnabled, includePrivate, &usedCandidates.at(i));
+            }
+            for(int i=0;i<oldProgram.size();i++) {
+                if(!isMatchValid(matches.at(i), usedCandidates.at(i))){
+                    usedCandidates.at(i).clear();
+                    matches.at(i) = matchFunction(i, docEnabled, includePrivate, &usedCandidates.at(i));
                 }
-                FunctionInstance func = oldProgram.at(i);
-
-                if (func.scope == "private" && !includePrivate) {
-                    //i++;
-                    continue;
+                if(matches.at(i).kind == MatchKind::RENAMED){
+                    consume(matches.at(i).newIndex);
                 }
+            }
 
-                auto index = findFunction(newProgram, func);
-                if (index == -1) {
-                    outputHandler->initialiseFunctionInstance(func);
-                    auto bodyStatus = findBody(func, docEnabled);
-                    // only output a renaming, if the similar function is not private, because knowing about a private function is not useful to the user
-                    if (bodyStatus.first == -1) {
-                        outputHandler->outputDeletedFunction(func, false);
-                        for (const auto &item: func.declarations){
-                            if(!item.isDeclaration || func.isDeclaration) continue;
-                            // the entire function is gone, this includes the decls
-                            outputHandler->outputDeletedFunction(item, false);
-                        }
-                    } else {
-                        // use the function found during the statistical functionanalysis
-                        FunctionInstance newFunc = newProgram.at(bodyStatus.first);
-                         if (newFunc.name != func.name) {
-                            // further checks on the Header to ensure, that this is indeed a renamed function
-                                if (docEnabled) {
-                                    outputHandler->outputRenamedFunction(newFunc, func.name,
-                                                                         std::to_string(bodyStatus.second));
-                                } else {
-                                    // perfect match, so using 100 is accurate
-                                    outputHandler->outputRenamedFunction(newFunc, func.name, "100");
-                                }
-                        } else {
-                            compareFunctionHeader(func, newFunc, false);
-                        }
-                        // remove the function from the newProgram, so that it is not compared again
-                        newProgram.erase(newProgram.begin() + bodyStatus.first);
-                    }
-                    outputHandler->endOfCurrentFunction();
-                    //++i;
-                } else if(index == -2){
-                    // function is newly overloaded and has to be added to the overloaded functions
-                    overloadedFunctions.push_back({func});
-                } else{
-                    outputHandler->initialiseFunctionInstance(func);
-                    FunctionInstance newFunc = newProgram.at(index);
-                    compareFunctionHeader(func, newFunc, false);
-                    outputHandler->endOfCurrentFunction();
-                    // TODO: delete the function from the newProgram, so that it is not compared again
-                    //++i;
-                }
+            // reporting: the table is replayed in the order of the old functions
+            for (const auto &match: matches) {
+                reportMatch(match, docEnabled, &overloadedFunctions);
             }
 
             // overloaded handling
             for(auto const& overloadedFunctionSet : overloadedFunctions){
-                FunctionInstance func = overloadedFunctionSet.at(0);
-                compareOverloadedFunctionHeader(func, overloadedFunctionSet);
+                compareOverloadedFunctionHeader(overloadedFunctionSet.at(0), overloadedFunctionSet);
             }
         }
     private:
-        // TODO: maybe open up the criterias more to recognize renamed Files + Functions
-        std::pair<int, double> findBody(const FunctionInstance &oldFunc, bool docEnabled) {
-            int currentHighest = -1;
-            double currentHighestValue = -1;
-            for (int i = 0; i < newProgram.size(); i++) {
-                FunctionInstance newFunc = newProgram.at(i);
-                if (newFunc.isDeclaration) {
-                    continue;
-                }
+        // only reads the state of the analyser (besides the candidates), so it can run for several old functions at once
+        FunctionMatch matchFunction(int oldPos, bool docEnabled, bool includePrivate, std::vector<int>* candidates) {
+            const FunctionInstance &func = oldProgram.at(oldPos);
+            FunctionMatch match;
+            match.oldIndex = oldPos;
+            if (func.scope == "private" && !includePrivate) {
+                return match;
+            }
+
+            auto index = findFunction(newProgram, newIndex, func, &consumed);
+            if (index == -2) {
+                // function is newly overloaded and has to be added to the overloaded functions
+                match.kind = MatchKind::OVERLOADED;
+            } else if (index != -1) {
+                match.kind = MatchKind::SAME;
+                match.newIndex = index;
+            } else {
+                auto bodyStatus = findBody(func, docEnabled, candidates);
+                match.kind = bodyStatus.first == -1 ? MatchKind::DELETED : MatchKind::RENAMED;
+                match.newIndex = bodyStatus.first;
+                match.score = bodyStatus.second;
+            }
+            return match;
+        }
+
+        /*
+         * consuming a new function only changes a match if it is the matched function itself (the searches keep their choice if any other function is left out)
+         * or if it was one of the candidates taken from the index, since another function would take its place
+         */
+        bool isMatchValid(const FunctionMatch &match, const std::vector<int> &candidates) {
+            if (match.newIndex != -1 && consumed.at(match.newIndex)) {
+                return false;
+            }
+            return std::none_of(candidates.begin(), candidates.end(), [this](int i){ return consumed.at(i); });
+        }
+
+        void consume(int index) {
+            consumed.at(index) = true;
+            if (bodyIndex) {
+                bodyIndex->remove(index);
+            }
+        }
+
+        void reportMatch(const FunctionMatch &match, bool docEnabled, std::vector<std::vector<FunctionInstance>>* overloadedFunctions) {
+            counter++;
+            if(counter % 2000 == 0){
+                outs() << "Analysed " << counter << " functions\n";
+            }
+            const FunctionInstance &func = oldProgram.at(match.oldIndex);
+
+            if (match.kind == MatchKind::SKIPPED) {
+                return;
+            }
+            if (match.kind == MatchKind::OVERLOADED) {
+                overloadedFunctions->push_back({func});
+                return;
+            }
+            outputHandler->initialiseFunctionInstance(func);
+            if (match.kind == MatchKind::DELETED) {
+                outputHandler->outputDeletedFunction(func, false);
+                for (const auto &item: func.declarations){
+                    if(!item.isDeclaration || func.isDeclaration) continue;
+                    // the entire function is gone, this includes the decls
+                    outputHandler->outputDeletedFunction(item, false);
+                }
+            } else if (match.kind == MatchKind::RENAMED && newProgram.at(match.newIndex).name != func.name) {
+                // only output a renaming, if the similar function is not private, because knowing about a private function is not useful to the user
+                const FunctionInstance &newFunc = newProgram.at(match.newIndex);
                 if (docEnabled) {
-                    // prioritize functions that have the exact same name in the same file
-                    if (oldFunc.name == newFunc.name) {
-                        double percentageDifference = matcher::compareFunctionBodies(oldFunc, newFunc);
-                        if(percentageDifference >= percentageCutOff)
-                            // check if found function has a match in the old program and if not, return its index (since findFunction checks for name AND file)
-                            if(findFunction(oldProgram, newFunc) == -1) return std::make_pair(i, percentageDifference);
-                    }
-                    // TODO: make the check less strict, so it can change renames AND other things, would be better to increase strictness of the matcher (i.e. minimum of characters, etc.)
-                    if (!compareFunctionHeader(oldFunc, newFunc, true)) {
-                        double percentageDifference = matcher::compareFunctionBodies(oldFunc, newFunc);
-                        if (percentageDifference >= percentageCutOff) {
-                            if (percentageDifference > currentHighestValue) {
-                                currentHighestValue = percentageDifference;
-                                currentHighest = i;
-                            }
-                        }
-                    }
+                    outputHandler->outputRenamedFunction(newFunc, func.name, std::to_string(match.score));
                 } else {
-                    // strip code of comments / empty spaces and then compares them
-                    if (helper::stripCodeOfEmptySpaces(helper::stripCodeOfComments(newFunc.body)) ==
-                        helper::stripCodeOfEmptySpaces(helper::stripCodeOfComments(oldFunc.body))) {
-                        currentHighestValue = 100;
-                        currentHighest = i;
-                        break;
-                    }
+                    // perfect match, so using 100 is accurate
+                    outputHandler->outputRenamedFunction(newFunc, func.name, "100");
                 }
+            } else {
+                // TODO: delete the function from the newProgram, if it was found by its name, so that it is not compared again
+                compareFunctionHeader(func, newProgram.at(match.newIndex), false);
             }
+            outputHandler->endOfCurrentFunction();
+        }
 
-            return std::make_pair(currentHighest, currentHighestValue);
+        // TODO: maybe open up the criterias more to recognize renamed Files + Functions
+        /*
+         * The scoring of the bodies runs in parallel, everything else in the order of the serial search (the header checks can write to the output), so the result is identical to it:
+         * the bodies of the functions with the same name are scored first, then the candidates are walked in order (returning the first function with the same name that is similar enough),
+         * the bodies of the candidates with the same header are scored afterwards and the most similar one wins (the first one of equally similar candidates)
+         */
+        // the candidates taken from the index are stored in usedCandidates
+        std::pair<int, double> findBody(const FunctionInstance &oldFunc, bool docEnabled, std::vector<int>* usedCandidates) {
+            if (!docEnabled) {
+                return findIdenticalBody(oldFunc);
+            }
+            // the buffers are reused for every function, that is matched by the thread
+            static thread_local std::vector<int> candidates;
+            static thread_local std::vector<double> scores;
+            static thread_local std::vector<int> sameName;
+            static thread_local std::vector<int> sameHeader;
+            static thread_local std::vector<int> unscored;
+            // with the index only the bodies that are likely similar are compared (in the same order as without it)
+            if (bodyIndex) {
+                *usedCandidates = bodyIndex->findCandidates(oldFunc, renameCandidates);
+                candidates.assign(usedCandidates->begin(), usedCandidates->end());
+            } else {
+                candidates.resize(newProgram.size());
+                std::iota(candidates.begin(), candidates.end(), 0);
+            }
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [this](int i){ return newProgram.at(i).isDeclaration || consumed.at(i); }), candidates.end());
+            std::string strippedBody = tokenSimilarity ? "" : helper::stripCodeOfEmptySpaces(helper::stripCodeOfComments(oldFunc.body));
+
+            // NaN if not scored (yet)
+            scores.assign(candidates.size(), std::nan(""));
+            sameName.clear();
+            for (int k = 0; k < candidates.size(); k++) {
+                if (newProgram.at(candidates.at(k)).name == oldFunc.name) {
+                    sameName.push_back(k);
+                }
+            }
+            scoreCandidates(oldFunc, strippedBody, candidates, sameName, &scores);
+
+            sameHeader.clear();
+            for (int k = 0; k < candidates.size(); k++) {
+                int i = candidates.at(k);
+                const FunctionInstance &newFunc = newProgram.at(i);
+                // prioritize functions that have the exact same name in the same file
+                if (oldFunc.name == newFunc.name) {
+                    double percentageDifference = scores.at(k);
+                    if(percentageDifference >= percentageCutOff)
+                        // check if found function has a match in the old program and if not, return its index (since findFunction checks for name AND file)
+                        if(findFunction(oldProgram, oldIndex, newFunc) == -1) return std::make_pair(i, percentageDifference);
+                }
+                // TODO: make the check less strict, so it can change renames AND other things, would be better to increase strictness of the matcher (i.e. minimum of characters, etc.)
+                if (!compareFunctionHeader(oldFunc, newFunc, true)) {
+                    sameHeader.push_back(k);
+                }
+            }
+
+            unscored.clear();
+            for (const auto &k: sameHeader) {
+                if (oldFunc.name != newProgram.at(candidates.at(k)).name) {
+                    unscored.push_back(k);
+                }
+            }
+            scoreCandidates(oldFunc, strippedBody, candidates, unscored, &scores);
+
+            BodyMatch best{-1, -1};
+            for (const auto &k: sameHeader) {
+                if (scores.at(k) >= percentageCutOff) {
+                    best = getBetterBodyMatch(best, BodyMatch{candidates.at(k), scores.at(k)});
+                }
+            }
+            return std::make_pair(best.index, best.score);
+        }
+
+        // scores the bodies of the given positions in the candidates,
+        // only in parallel if it is not called from the parallel matching loop, otherwise every thread of it would start jobs threads
+        void scoreCandidates(const FunctionInstance &oldFunc, std::string_view strippedBody, const std::vector<int> &candidates, const std::vector<int> &positions, std::vector<double>* scores) {
+            #pragma omp parallel for schedule(dynamic) num_threads(jobs) if(!omp_in_parallel())
+            for (int x = 0; x < positions.size(); x++) {
+                int k = positions.at(x);
+                scores->at(k) = compareBodies(oldFunc, strippedBody, candidates.at(k));
+            }
+        }
+
+        // compares with the function at newPos in the newProgram, whose body was already stripped
+        double compareBodies(const FunctionInstance &oldFunc, std::string_view strippedBody, int newPos) {
+            if (tokenSimilarity) {
+                return matcher::compareFunctionBodyTokens(oldFunc, newProgram.at(newPos), percentageCutOff);
+            }
+            return matcher::compareStrippedBodies(strippedBody, strippedNewBodies.at(newPos), percentageCutOff);
+        }
+
+        double compareBodies(const FunctionInstance &oldFunc, const FunctionInstance &newFunc) {
+            if (tokenSimilarity) {
+                return matcher::compareFunctionBodyTokens(oldFunc, newFunc, percentageCutOff);
+            }
+            return matcher::compareFunctionBodies(oldFunc, newFunc, percentageCutOff);
         }
 
-        std::pair<FunctionInstance, double> findBody(const FunctionInstance &oldFunc, const std::vector<FunctionInstance> &funcSubset) {
-            FunctionInstance currentHighest;
+        // the first definition in the newProgram with the same body (without comments / empty spaces) as the old function
+        std::pair<int, double> findIdenticalBody(const FunctionInstance &oldFunc) {
+            auto found = newBodyHashes.find(oldFunc.bodyHash);
+            if (found == newBodyHashes.end()) {
+                return std::make_pair(-1, -1);
+            }
+            std::string strippedBody = helper::stripCodeOfEmptySpaces(helper::stripCodeOfComments(oldFunc.body));
+            for (const auto &i: found->second) {
+                if (consumed.at(i)) continue;
+                // the bodies are compared anyway, so a collision of the hashes can not cause a wrong rename
+                if (strippedNewBodies.at(i) == strippedBody) {
+                    return std::make_pair(i, 100);
+                }
+            }
+            return std::make_pair(-1, -1);
+        }
+
+        // the index in the funcSubset of the most similar body (-1 if there is none)
+        std::pair<int, double> findBody(const FunctionInstance &oldFunc, const std::vector<FunctionInstance> &funcSubset) {
+            int currentHighest = -1;
             double currentHighestValue = -1;
-            for (auto const &newFunc: funcSubset) {
+            for (int i = 0; i < funcSubset.size(); i++) {
+                const FunctionInstance &newFunc = funcSubset.at(i);
                 if (newFunc.isDeclaration) {
                     continue;
                 }
-                double percentageDifference = matcher::compareFunctionBodies(oldFunc, newFunc);
+                double percentageDifference = compareBodies(oldFunc, newFunc);
 
                 if (percentageDifference >= percentageCutOff) {
                     if (percentageDifference > currentHighestValue) {
                         currentHighestValue = percentageDifference;
-                        currentHighest = newFunc;
+                        currentHighest = i;
                     }
                 }
             }
@@ -283,7 +544,8 @@ namespace functionanalysis{
         }
 
         bool compareOverloadedFunctionHeader(const FunctionInstance &func, const std::vector<FunctionInstance>& oldOverloadedInstances) {
-            std::vector<FunctionInstance> overloadedFunctions;
+            // the set of the new program with the same functions (not copied, since it is only read)
+            const std::vector<FunctionInstance>* overloadedFunctions = nullptr;
             for(int x=0;x<oldOverloadedInstances.size();x++) {
                 for (int i = 0; i < newOverloadedFunctions.size(); i++) {
                     if(oldOverloadedInstances.at(x).qualifiedName != newOverloadedFunctions.at(i).at(0).qualifiedName) {
@@ -292,7 +554,7 @@ namespace functionanalysis{
                     for (int j = 0; j < newOverloadedFunctions.at(i).size(); j++) {
                         if (oldOverloadedInstances.at(x).qualifiedName == newOverloadedFunctions.at(i).at(j).qualifiedName &&
                                 oldOverloadedInstances.at(x).filename == newOverloadedFunctions.at(i).at(j).filename) {
-                            overloadedFunctions = newOverloadedFunctions.at(i);
+                            overloadedFunctions = &newOverloadedFunctions.at(i);
                             break;
                         }
                     }
@@ -303,7 +565,7 @@ namespace functionanalysis{
             for (const auto &item: oldOverloadedInstances) {
                 outputHandler->initialiseFunctionInstance(item);
 
-                if (overloadedFunctions.empty()) {
+                if (!overloadedFunctions) {
                     outputHandler->outputDeletedFunction(func, true);
                     for (const auto &decl: func.declarations){
                         if(!decl.isDeclaration || item.isDeclaration) continue;
@@ -315,7 +577,7 @@ namespace functionanalysis{
                 }
 
                 bool found = false;
-                for (const auto &newFunc: overloadedFunctions){
+                for (const auto &newFunc: *overloadedFunctions){
                     if(item.equals(newFunc)){
                         compareParams(item, newFunc, false);
                         compareFunctionHeaderExceptParams(item, newFunc, false);
@@ -327,11 +589,11 @@ namespace functionanalysis{
                 }
 
                 // if there isn't an exact match, find the nearest match
-                auto closest = findBody(item, overloadedFunctions);
+                auto closest = findBody(item, *overloadedFunctions);
                 if (closest.second != -1) {
                     // there is another function that fits, proceed to compare it normally
-                    compareParams(item, closest.first, false);
-                    compareFunctionHeaderExceptParams(item, closest.first, false);
+                    compareParams(item, overloadedFunctions->at(closest.first), false);
+                    compareFunctionHeaderExceptParams(item, overloadedFunctions->at(closest.first), false);
                     // TODO: block for multiple old functions to be mapped to a single new function? (i.e. delete the here found function as well)
                 } else {
                     outputHandler->outputDeletedFunction(item, true);
@@ -349,8 +611,13 @@ namespace functionanalysis{
 
         bool compareFunctionTemplates(const FunctionInstance &func, const FunctionInstance &newFunc, bool internalUse){
             bool output = false;
-            // comparing the template parameters
-            vector<matcher::Operation> operations = matcher::getOptimalParamConversion(func.templateParams, newFunc.templateParams);
+            // comparing the template parameters (the header checks of the search only need to know if they differ)
+            vector<matcher::Operation> operations;
+            if(internalUse){
+                output = matcher::paramsDiffer(func.templateParams, newFunc.templateParams);
+            }else{
+                operations = matcher::getOptimalParamConversion(func.templateParams, newFunc.templateParams);
+            }
 
             if(!operations.empty()){
                 output = true;
@@ -385,7 +652,7 @@ namespace functionanalysis{
                     }
                 }
                 if(!found){
-                    outputHandler->outputDeletedSpecialization(item);
+                    if(!internalUse) outputHandler->outputDeletedSpecialization(item);
                     output = true;
                 }
             }
@@ -399,7 +666,7 @@ namespace functionanalysis{
                     }
                 }
                 if(!found){
-                    outputHandler->outputNewSpecialization(item);
+                    if(!internalUse) outputHandler->outputNewSpecialization(item);
                     output = true;
                 }
             }
@@ -433,7 +700,9 @@ namespace functionanalysis{
             output += compareFile(func, newFunc, internalUse);
 
             // Declarations are not part of the function header and should therefore not be included in the check of function header similarity
-            compareDeclarations(func, newFunc, internalUse);
+            if (!internalUse) {
+                compareDeclarations(func, newFunc, internalUse);
+            }
 
             output += compareStorageClass(func, newFunc, internalUse);
 
@@ -445,13 +714,14 @@ namespace functionanalysis{
         }
 
         bool compareParams(const FunctionInstance &func, const FunctionInstance &newFunc, bool internalUse) {
+            // the header checks of the search and of the template specializations only need to know if the params differ
+            if (internalUse) {
+                return matcher::paramsDiffer(func.params, newFunc.params);
+            }
             bool output = false;
             vector<matcher::Operation> operations = matcher::getOptimalParamConversion(func.params, newFunc.params);
 
             if (!operations.empty()) {
-                if (internalUse) {
-                    return true;
-                }
                 output = true;
                 for (const auto &item: operations) {
                     if (item.type == matcher::Operation::Types::REPLACEMENT) {
@@ -2,9 +2,12 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <unordered_set>
 #include "header/HelperFunctions.h"
 #include <filesystem>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/xxhash.h>
 #include <csignal>
 
 namespace fs = std::filesystem;
@@ -100,6 +103,11 @@ namespace helper {
         return code;
     }
 
+    // hash of the body without comments and empty spaces, two bodies with the same hash are (almost certainly) identical for the rename detection
+    uint64_t getNormalizedBodyHash(const std::string& body){
+        return llvm::xxHash64(stripCodeOfEmptySpaces(stripCodeOfComments(body)));
+    }
+
     std::vector<std::string> convertPairIntoFlatVector(const std::vector<std::pair<std::string, std::pair<std::string, std::string>>>& vec){
         std::vector<std::string> output;
         for (const auto &item: vec){
@@ -196,70 +204,100 @@ namespace helper {
 
     std::map<std::string, std::string> createRelativeMap(const std::vector<std::string>& files, const std::string& path, bool old);
 
-    std::pair<std::vector<std::string>, std::vector<std::string>> filterUnchangedFiles(const std::vector<std::string>& oldFiles, const std::vector<std::string>& newFiles, std::string oldPath, std::string newPath){
+    // compares the contents of two files without starting another process (files that can not be read are treated as changed)
+    bool filesAreEqual(const std::string& oldFile, const std::string& newFile){
+        std::error_code errorCode;
+        auto oldSize = fs::file_size(oldFile, errorCode);
+        if(errorCode){
+            return false;
+        }
+        auto newSize = fs::file_size(newFile, errorCode);
+        if(errorCode || oldSize != newSize){
+            return false;
+        }
+        uint64_t oldHash;
+        uint64_t newHash;
+        return hashFile(oldFile, &oldHash) && hashFile(newFile, &newHash) && oldHash == newHash;
+    }
+
+    // a file pair with the same content is only filtered out if the files it includes are also unchanged (checked through includesUnchanged, which is called in parallel)
+    std::pair<std::vector<std::string>, std::vector<std::string>> filterUnchangedFiles(const std::vector<std::string>& oldFiles, const std::vector<std::string>& newFiles, std::string oldPath, std::string newPath, const std::function<bool(const std::string&, const std::string&)>& includesUnchanged, int jobs){
         std::vector<std::string> oldOutput;
         std::vector<std::string> newOutput;
         // keep track of the found new files to later be able to add them to the output
         // this is done since new files that dont have an equivalent in the old files are not compared and therefore not added in the normal workflow
-        std::vector<std::string> removedNewFiles;
+        std::unordered_set<std::string> removedNewFiles;
         // create a map with the input paths of the old files as key
         auto oldRelativeMap = createRelativeMap(oldFiles, oldPath, true);
         // create a map with the relative paths of the new / old files as key (since for a file in both versions the relative path is the same)
         auto newRelativeMap = createRelativeMap(newFiles, newPath, false);
 
+        // the new file of every old file (empty if there is none)
+        std::vector<std::string> correspondingNewFiles(oldFiles.size());
         for (int i=0; i<oldFiles.size(); i++) {
-
             if(oldFiles.at(i).empty()){
                 continue;
             }
+            auto newFile = newRelativeMap.find(oldRelativeMap.at(oldFiles.at(i)));
+            if (newFile != newRelativeMap.end()) {
+                correspondingNewFiles.at(i) = newFile->second;
+            }
+        }
+
+        // the comparisons are independent of each other, so they are done in parallel
+        std::vector<char> unchanged(oldFiles.size(), false);
+        #pragma omp parallel for schedule(dynamic, 16) num_threads(std::max(1, jobs))
+        for (int i=0; i<(int) oldFiles.size(); i++) {
+            if(!correspondingNewFiles.at(i).empty()){
+                unchanged.at(i) = filesAreEqual(fs::absolute(oldFiles.at(i)), fs::absolute(correspondingNewFiles.at(i))) && (!includesUnchanged || includesUnchanged(oldFiles.at(i), correspondingNewFiles.at(i)));
+            }
+        }
 
-            // get the absolute old file path
-            std::string absoluteOldFile = fs::absolute(oldFiles.at(i));
+        for (int i=0; i<oldFiles.size(); i++) {
+
+            if(oldFiles.at(i).empty()){
+                continue;
+            }
 
             // check if the file is present in the new files, if not the oldFile is added to the output
-            if (newRelativeMap.find(oldRelativeMap.at(oldFiles.at(i))) == newRelativeMap.end()) {
+            if (correspondingNewFiles.at(i).empty()) {
                 oldOutput.push_back(oldFiles.at(i));
                 continue;
             }
-            // get the absolute new filepath by using the relative path from the old file
-            std::string absoluteNewFile = fs::absolute(newRelativeMap.at(oldRelativeMap.at(oldFiles.at(i))));
-
-            std::array<char, 128> buffer{};
-            std::string txt;
-            // create diff command with the absolute file paths
-            std::string command = "diff -q " + absoluteOldFile + " " + absoluteNewFile;
-            // execute the command
-            // TODO: this is a security risk, because the command is not checked for malicious code (not sure if relevant, but another way to do this would be nice)
-            std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(command.c_str(), "r"), pclose);
-            if (!pipe) {
-                throw std::runtime_error("popen() failed!");
-            }
-            // read the output of the command
-            while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-                txt += buffer.data();
-            }
 
-            // if the output is not empty, the files have changes and need to be processed by ALPACA
-            if (!txt.empty()) {
+            // if the files differ, they have changes and need to be processed by ALPACA
+            if (!unchanged.at(i)) {
                 oldOutput.push_back(oldFiles.at(i));
-                newOutput.push_back(newRelativeMap.at(oldRelativeMap.at(oldFiles.at(i))));
+                newOutput.push_back(correspondingNewFiles.at(i));
             } else {
-                // if the output is empty, the files are the same and this is noted in the removedFiles list
-                removedNewFiles.push_back(newRelativeMap.at(oldRelativeMap.at(oldFiles.at(i))));
+                // if the files are the same this is noted in the removedFiles list
+                removedNewFiles.insert(correspondingNewFiles.at(i));
             }
         }
 
         // add all new files that were found to be equal to an old file to the output
+        std::unordered_set<std::string> addedNewFiles(newOutput.begin(), newOutput.end());
         for (int i=0; i<newFiles.size(); i++) {
             // check if the file is either in the removed files or the new output, if not add it to the new output
-            if (std::find(removedNewFiles.begin(), removedNewFiles.end(), newFiles.at(i)) == removedNewFiles.end() && std::find(newOutput.begin(), newOutput.end(), newFiles.at(i)) == newOutput.end()) {
+            if (removedNewFiles.count(newFiles.at(i)) == 0 && addedNewFiles.count(newFiles.at(i)) == 0) {
                 newOutput.push_back(newFiles.at(i));
+                addedNewFiles.insert(newFiles.at(i));
             }
         }
 
         return std::make_pair(oldOutput, newOutput);
     }
 
+    // hashes the content of a file (larger files are memory mapped instead of read), returns false if the file could not be opened
+    bool hashFile(const std::string& path, uint64_t* hash){
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if(!buffer){
+            return false;
+        }
+        *hash = llvm::xxHash64((*buffer)->getBuffer());
+        return true;
+    }
+
     std::string makeRelative(const std::string& file, const std::string& dir) {
         return std::filesystem::relative(file, fs::canonical(std::filesystem::absolute(dir)).string());
     }
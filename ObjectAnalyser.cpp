@@ -12,24 +12,27 @@ namespace objectanalysis{
     class ObjectAnalyser{
         std::vector<ObjectInstance> oldObjects;
         std::vector<ObjectInstance> newObjects;
+        // new objects that were already matched (instead of erasing them, so the indices stay the same)
+        std::vector<char> consumed;
         OutputHandler* outputHandler;
 
-        int findObject(const std::vector<ObjectInstance>& set, const ObjectInstance& objectInstance){
+        int findObject(const std::vector<ObjectInstance>& set, const ObjectInstance& objectInstance, const std::vector<char>& skipped){
             // prioritylist (name has to be the same): qualifiedName > filename > closest match on location
-            std::map<int, ObjectInstance> possibleMatches;
+            std::vector<int> possibleMatches;
             for(int i=0;i<set.size();i++){
+                if(skipped.at(i)) continue;
                 if(set.at(i).qualifiedName == objectInstance.qualifiedName && set.at(i).qualifiedName != "" && set.at(i).qualifiedName != "(anonymous)"){
                     //return i;
                 }
                 // qualifiedName is included, because anonymous objects dont have a name, but a qualifiedName
                 if(set.at(i).name == objectInstance.name || set.at(i).qualifiedName == objectInstance.qualifiedName){
-                    possibleMatches.insert(std::make_pair(i, set.at(i)));
+                    possibleMatches.push_back(i);
                 }
             }
             for(const auto& possibleMatch: possibleMatches){
                 // return the first match with the same filename
-                if(possibleMatch.second.filename == objectInstance.filename){
-                    return possibleMatch.first;
+                if(set.at(possibleMatch).filename == objectInstance.filename){
+                    return possibleMatch;
                 }
             }
 
@@ -38,11 +41,12 @@ namespace objectanalysis{
             // if there isn't even a match with the same filename, return the object with the closest matching location
             int smallestDiff = std::numeric_limits<int>::max();
             int candidate = -1;
-            for (const auto &item: possibleMatches){
-                auto matrix = matcher::levenshteinDistance(item.second.location, objectInstance.location);
-                if(smallestDiff > matrix[item.second.location.size()][objectInstance.location.size()]){
-                    smallestDiff = matrix[item.second.location.size()][objectInstance.location.size()];
-                    candidate = item.first;
+            for (const auto &possibleMatch: possibleMatches){
+                const auto &location = set.at(possibleMatch).location;
+                auto matrix = matcher::levenshteinDistance(location, objectInstance.location);
+                if(smallestDiff > matrix[location.size()][objectInstance.location.size()]){
+                    smallestDiff = matrix[location.size()][objectInstance.location.size()];
+                    candidate = possibleMatch;
                 }
             }
              */
@@ -59,11 +63,12 @@ namespace objectanalysis{
         }
 
         void compareObjects(){
+            consumed.assign(newObjects.size(), false);
             for (const auto &item: oldObjects){
                 outputHandler->initialiseObjectInstance(item);
-                auto indexInNew = findObject(newObjects, item);
+                auto indexInNew = findObject(newObjects, item, consumed);
                 if(indexInNew != -1){
-                    ObjectInstance newItem = newObjects.at(indexInNew);
+                    const ObjectInstance& newItem = newObjects.at(indexInNew);
                     compareFilename(item, newItem);
                     compareLocation(item, newItem);
                     compareType(item, newItem);
@@ -73,7 +78,7 @@ namespace objectanalysis{
                     if(item.isAbstract != newItem.isAbstract){
                         outputHandler->outputObjectAbstractChange(item, newItem);
                     }
-                    newObjects.erase(newObjects.begin() + indexInNew);
+                    consumed.at(indexInNew) = true;
                 }else{
                     outputHandler->outputObjectDeleted(item);
                 }
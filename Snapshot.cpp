@@ -0,0 +1,455 @@
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include "header/FunctionAnalyser.h"
+#include "header/VariableAnalyser.h"
+#include "header/ObjectAnalyser.h"
+
+using namespace functionanalysis;
+using namespace variableanalysis;
+using namespace objectanalysis;
+
+namespace extraction {
+
+    /*
+     * Binary snapshot of an extracted version (the functions after the undefined declarations were added, the variables and the objects)
+     * Layout: header, string offsets, string data, string lists, parameters, functions, variables, objects (every section is aligned to 8 bytes)
+     * All strings are stored once in the string table and referenced by their index, everything else consists of fixed-width records,
+     * lists (e.g. the declarations of a function) are ranges into the corresponding section, so a snapshot is loaded by mapping it into memory
+     * The positions of the instances are not part of a snapshot, they are only needed during the extraction
+     */
+    namespace snapshot {
+        const char magic[8] = {'A', 'L', 'P', 'A', 'C', 'A', 'S', 'N'};
+        // increase if the layout or the extracted instances change
+        const uint32_t formatVersion = 2;
+
+        struct Header {
+            char magic[8];
+            uint32_t formatVersion;
+            uint32_t stringCount;
+            uint64_t stringDataSize;
+            uint32_t stringListSize;
+            uint32_t paramCount;
+            uint32_t functionCount;
+            // the first functions are the program, the remaining ones are their declarations and specializations
+            uint32_t programSize;
+            uint32_t variableCount;
+            uint32_t objectCount;
+        };
+
+        struct Range {
+            uint32_t start;
+            uint32_t count;
+        };
+
+        struct ParamRecord {
+            uint32_t type;
+            uint32_t name;
+            uint32_t defaultValue;
+        };
+
+        struct FunctionRecord {
+            uint64_t bodyHash;
+            uint32_t name;
+            uint32_t qualifiedName;
+            uint32_t returnType;
+            uint32_t body;
+            uint32_t filename;
+            uint32_t scope;
+            uint32_t storageClass;
+            uint32_t memberFunctionSpecifier;
+            uint32_t fullHeader;
+            // into the parameters
+            Range params;
+            Range templateParams;
+            // into the string lists
+            Range location;
+            // into the functions
+            Range declarations;
+            Range templateSpecializations;
+            uint8_t isDeclaration;
+            uint8_t isConst;
+            uint8_t isTemplateDecl;
+            uint8_t isTemplateSpec;
+        };
+
+        struct VariableRecord {
+            uint32_t name;
+            uint32_t qualifiedName;
+            uint32_t type;
+            uint32_t filename;
+            uint32_t storageClass;
+            uint32_t accessSpecifier;
+            uint32_t qualifiers;
+            Range location;
+            uint8_t isClassMember;
+            uint8_t isInline;
+            uint8_t isConst;
+            uint8_t isExplicit;
+            uint8_t isVolatile;
+            uint8_t isMutable;
+            uint8_t padding[2];
+        };
+
+        struct ObjectRecord {
+            int32_t objectType;
+            uint32_t name;
+            uint32_t qualifiedName;
+            uint32_t filename;
+            Range location;
+            uint8_t isAbstract;
+            uint8_t isFinal;
+            uint8_t padding[2];
+        };
+
+        inline size_t alignedSize(size_t size){
+            return (size + 7) & ~((size_t) 7);
+        }
+    }
+
+    class SnapshotWriter {
+    public:
+        // returns false if the snapshot could not be written
+        bool write(const std::string& path, const std::vector<FunctionInstance>& program, const std::vector<VariableInstance>& variables, const std::vector<ObjectInstance>& objects){
+            // the functions are written breadth first, so the program is at the beginning and the nested functions of every function are consecutive
+            std::vector<const FunctionInstance*> order;
+            order.reserve(program.size());
+            for (const auto &item: program){
+                order.push_back(&item);
+            }
+            for(size_t i = 0; i < order.size(); i++){
+                const FunctionInstance& function = *order.at(i);
+                snapshot::FunctionRecord record{};
+                record.name = addString(function.name);
+                record.qualifiedName = addString(function.qualifiedName);
+                record.returnType = addString(function.returnType);
+                record.body = addString(function.body);
+                record.bodyHash = function.bodyHash;
+                record.filename = addString(function.filename);
+                record.scope = addString(function.scope);
+                record.storageClass = addString(function.storageClass);
+                record.memberFunctionSpecifier = addString(function.memberFunctionSpecifier);
+                record.fullHeader = addString(function.fullHeader);
+                record.params = addParams(function.params);
+                record.templateParams = addParams(function.templateParams);
+                record.location = addStringList(function.location);
+                record.declarations = {(uint32_t) order.size(), (uint32_t) function.declarations.size()};
+                for (const auto &item: function.declarations){
+                    order.push_back(&item);
+                }
+                record.templateSpecializations = {(uint32_t) order.size(), (uint32_t) function.templateSpecializations.size()};
+                for (const auto &item: function.templateSpecializations){
+                    order.push_back(&item);
+                }
+                record.isDeclaration = function.isDeclaration;
+                record.isConst = function.isConst;
+                record.isTemplateDecl = function.isTemplateDecl;
+                record.isTemplateSpec = function.isTemplateSpec;
+                functions.push_back(record);
+            }
+
+            for (const auto &variable: variables){
+                snapshot::VariableRecord record{};
+                record.name = addString(variable.name);
+                record.qualifiedName = addString(variable.qualifiedName);
+                record.type = addString(variable.type);
+                record.filename = addString(variable.filename);
+                record.storageClass = addString(variable.storageClass);
+                record.accessSpecifier = addString(variable.accessSpecifier);
+                record.qualifiers = addString(variable.qualifiers);
+                record.location = addStringList(variable.location);
+                record.isClassMember = variable.isClassMember;
+                record.isInline = variable.isInline;
+                record.isConst = variable.isConst;
+                record.isExplicit = variable.isExplicit;
+                record.isVolatile = variable.isVolatile;
+                record.isMutable = variable.isMutable;
+                variableRecords.push_back(record);
+            }
+
+            for (const auto &object: objects){
+                snapshot::ObjectRecord record{};
+                record.objectType = object.objectType;
+                record.name = addString(object.name);
+                record.qualifiedName = addString(object.qualifiedName);
+                record.filename = addString(object.filename);
+                record.location = addStringList(object.location);
+                record.isAbstract = object.isAbstract;
+                record.isFinal = object.isFinal;
+                objectRecords.push_back(record);
+            }
+
+            snapshot::Header header{};
+            std::memcpy(header.magic, snapshot::magic, sizeof(header.magic));
+            header.formatVersion = snapshot::formatVersion;
+            header.stringCount = stringOffsets.size();
+            header.stringDataSize = stringData.size();
+            header.stringListSize = stringLists.size();
+            header.paramCount = params.size();
+            header.functionCount = functions.size();
+            header.programSize = program.size();
+            header.variableCount = variableRecords.size();
+            header.objectCount = objectRecords.size();
+            stringOffsets.push_back(stringData.size());
+
+            std::error_code errorCode;
+            llvm::raw_fd_ostream output(path, errorCode);
+            if(errorCode){
+                return false;
+            }
+            writeSection(output, &header, sizeof(header));
+            writeSection(output, stringOffsets.data(), stringOffsets.size() * sizeof(uint64_t));
+            writeSection(output, stringData.data(), stringData.size());
+            writeSection(output, stringLists.data(), stringLists.size() * sizeof(uint32_t));
+            writeSection(output, params.data(), params.size() * sizeof(snapshot::ParamRecord));
+            writeSection(output, functions.data(), functions.size() * sizeof(snapshot::FunctionRecord));
+            writeSection(output, variableRecords.data(), variableRecords.size() * sizeof(snapshot::VariableRecord));
+            writeSection(output, objectRecords.data(), objectRecords.size() * sizeof(snapshot::ObjectRecord));
+            output.close();
+            return !output.has_error();
+        }
+
+    private:
+        std::unordered_map<std::string, uint32_t> stringIds;
+        std::vector<uint64_t> stringOffsets;
+        std::string stringData;
+        std::vector<uint32_t> stringLists;
+        std::vector<snapshot::ParamRecord> params;
+        std::vector<snapshot::FunctionRecord> functions;
+        std::vector<snapshot::VariableRecord> variableRecords;
+        std::vector<snapshot::ObjectRecord> objectRecords;
+
+        uint32_t addString(const std::string& string){
+            auto found = stringIds.find(string);
+            if(found != stringIds.end()){
+                return found->second;
+            }
+            stringOffsets.push_back(stringData.size());
+            stringData += string;
+            stringIds.insert(std::make_pair(string, stringOffsets.size() - 1));
+            return stringOffsets.size() - 1;
+        }
+
+        snapshot::Range addStringList(const std::vector<std::string>& list){
+            snapshot::Range range{(uint32_t) stringLists.size(), (uint32_t) list.size()};
+            for (const auto &item: list){
+                stringLists.push_back(addString(item));
+            }
+            return range;
+        }
+
+        snapshot::Range addParams(const std::vector<std::pair<std::string, std::pair<std::string, std::string>>>& list){
+            snapshot::Range range{(uint32_t) params.size(), (uint32_t) list.size()};
+            for (const auto &item: list){
+                params.push_back({addString(item.first), addString(item.second.first), addString(item.second.second)});
+            }
+            return range;
+        }
+
+        static void writeSection(llvm::raw_fd_ostream& output, const void* data, size_t size){
+            output.write((const char*) data, size);
+            output.write_zeros(snapshot::alignedSize(size) - size);
+        }
+    };
+
+    class SnapshotReader {
+    public:
+        // returns false if the file is not a (complete) snapshot of this version of the tool, the vectors are only extended if it could be read completely
+        bool read(const std::string& path, std::vector<FunctionInstance>* program, std::vector<VariableInstance>* variables, std::vector<ObjectInstance>* objects){
+            std::vector<FunctionInstance> readProgram;
+            std::vector<VariableInstance> readVariables;
+            std::vector<ObjectInstance> readObjects;
+            try {
+                if(!readSections(path, &readProgram, &readVariables, &readObjects)){
+                    return false;
+                }
+            } catch (std::out_of_range &e) {
+                // a truncated or otherwise broken snapshot references data outside of its sections
+                llvm::outs() << "The snapshot " << path << " is invalid: " << e.what() << "\n";
+                return false;
+            }
+            program->insert(program->end(), std::make_move_iterator(readProgram.begin()), std::make_move_iterator(readProgram.end()));
+            variables->insert(variables->end(), std::make_move_iterator(readVariables.begin()), std::make_move_iterator(readVariables.end()));
+            objects->insert(objects->end(), std::make_move_iterator(readObjects.begin()), std::make_move_iterator(readObjects.end()));
+            return true;
+        }
+
+    private:
+        std::unique_ptr<llvm::MemoryBuffer> buffer;
+        snapshot::Header header{};
+        const uint64_t* stringOffsets;
+        const char* stringData;
+        const uint32_t* stringLists;
+        const snapshot::ParamRecord* params;
+        const snapshot::FunctionRecord* functions;
+
+        bool readSections(const std::string& path, std::vector<FunctionInstance>* program, std::vector<VariableInstance>* variables, std::vector<ObjectInstance>* objects){
+            auto file = llvm::MemoryBuffer::getFile(path);
+            if(!file){
+                return false;
+            }
+            buffer = std::move(*file);
+            const char* data = buffer->getBufferStart();
+            size_t size = buffer->getBufferSize();
+            if(size < sizeof(snapshot::Header)){
+                return false;
+            }
+            std::memcpy(&header, data, sizeof(header));
+            if(std::memcmp(header.magic, snapshot::magic, sizeof(header.magic)) != 0 || header.formatVersion != snapshot::formatVersion){
+                return false;
+            }
+            // checked before the sections are computed, so the offsets can not overflow
+            if(header.stringDataSize > size){
+                throw std::out_of_range("the string data is larger than the file");
+            }
+
+            size_t offset = snapshot::alignedSize(sizeof(header));
+            stringOffsets = (const uint64_t*) (data + offset);
+            offset += snapshot::alignedSize((header.stringCount + 1) * sizeof(uint64_t));
+            stringData = data + offset;
+            offset += snapshot::alignedSize(header.stringDataSize);
+            stringLists = (const uint32_t*) (data + offset);
+            offset += snapshot::alignedSize(header.stringListSize * sizeof(uint32_t));
+            params = (const snapshot::ParamRecord*) (data + offset);
+            offset += snapshot::alignedSize(header.paramCount * sizeof(snapshot::ParamRecord));
+            functions = (const snapshot::FunctionRecord*) (data + offset);
+            offset += snapshot::alignedSize(header.functionCount * sizeof(snapshot::FunctionRecord));
+            auto variableRecords = (const snapshot::VariableRecord*) (data + offset);
+            offset += snapshot::alignedSize(header.variableCount * sizeof(snapshot::VariableRecord));
+            auto objectRecords = (const snapshot::ObjectRecord*) (data + offset);
+            offset += snapshot::alignedSize(header.objectCount * sizeof(snapshot::ObjectRecord));
+            if(offset != size){
+                throw std::out_of_range("the sections do not match the size of the file");
+            }
+            if(header.programSize > header.functionCount){
+                throw std::out_of_range("the program has more functions than the snapshot");
+            }
+            for(uint64_t i = 0; i <= header.stringCount; i++){
+                if(stringOffsets[i] > header.stringDataSize || (i > 0 && stringOffsets[i] < stringOffsets[i - 1])){
+                    throw std::out_of_range("string offset " + std::to_string(i) + " is out of range");
+                }
+            }
+
+            program->reserve(program->size() + header.programSize);
+            for(uint32_t i = 0; i < header.programSize; i++){
+                program->push_back(getFunction(i));
+            }
+
+            variables->reserve(variables->size() + header.variableCount);
+            for(uint32_t i = 0; i < header.variableCount; i++){
+                const auto& record = variableRecords[i];
+                VariableInstance variable;
+                variable.name = getString(record.name);
+                variable.qualifiedName = getString(record.qualifiedName);
+                variable.type = getString(record.type);
+                variable.filename = getString(record.filename);
+                variable.storageClass = getString(record.storageClass);
+                variable.accessSpecifier = getString(record.accessSpecifier);
+                variable.qualifiers = getString(record.qualifiers);
+                variable.location = getStringList(record.location);
+                variable.isClassMember = record.isClassMember;
+                variable.isInline = record.isInline;
+                variable.isConst = record.isConst;
+                variable.isExplicit = record.isExplicit;
+                variable.isVolatile = record.isVolatile;
+                variable.isMutable = record.isMutable;
+                variables->push_back(std::move(variable));
+            }
+
+            objects->reserve(objects->size() + header.objectCount);
+            for(uint32_t i = 0; i < header.objectCount; i++){
+                const auto& record = objectRecords[i];
+                ObjectInstance object;
+                object.objectType = (clang::TagTypeKind) record.objectType;
+                object.name = getString(record.name);
+                object.qualifiedName = getString(record.qualifiedName);
+                object.filename = getString(record.filename);
+                object.location = getStringList(record.location);
+                object.isAbstract = record.isAbstract;
+                object.isFinal = record.isFinal;
+                objects->push_back(std::move(object));
+            }
+            return true;
+        }
+
+        static void checkRange(snapshot::Range range, uint64_t sectionSize, const char* section){
+            if((uint64_t) range.start + range.count > sectionSize){
+                throw std::out_of_range(std::string("range in the ") + section + " is out of range");
+            }
+        }
+
+        std::string getString(uint32_t id) const {
+            if(id >= header.stringCount){
+                throw std::out_of_range("string " + std::to_string(id) + " is out of range");
+            }
+            return std::string(stringData + stringOffsets[id], stringOffsets[id + 1] - stringOffsets[id]);
+        }
+
+        std::vector<std::string> getStringList(snapshot::Range range) const {
+            checkRange(range, header.stringListSize, "string lists");
+            std::vector<std::string> list;
+            list.reserve(range.count);
+            for(uint32_t i = range.start; i < range.start + range.count; i++){
+                list.push_back(getString(stringLists[i]));
+            }
+            return list;
+        }
+
+        std::vector<std::pair<std::string, std::pair<std::string, std::string>>> getParams(snapshot::Range range) const {
+            checkRange(range, header.paramCount, "parameters");
+            std::vector<std::pair<std::string, std::pair<std::string, std::string>>> list;
+            list.reserve(range.count);
+            for(uint32_t i = range.start; i < range.start + range.count; i++){
+                list.emplace_back(getString(params[i].type), std::make_pair(getString(params[i].name), getString(params[i].defaultValue)));
+            }
+            return list;
+        }
+
+        FunctionInstance getFunction(uint32_t index) const {
+            if(index >= header.functionCount){
+                throw std::out_of_range("function " + std::to_string(index) + " is out of range");
+            }
+            const auto& record = functions[index];
+            // the nested functions are always written after their function, which also rules out cycles
+            for (const auto &range: {record.declarations, record.templateSpecializations}){
+                checkRange(range, header.functionCount, "functions");
+                if(range.count > 0 && range.start <= index){
+                    throw std::out_of_range("the nested functions of function " + std::to_string(index) + " are out of order");
+                }
+            }
+            FunctionInstance function;
+            function.name = getString(record.name);
+            function.qualifiedName = getString(record.qualifiedName);
+            function.returnType = getString(record.returnType);
+            function.body = getString(record.body);
+            function.bodyHash = record.bodyHash;
+            function.filename = getString(record.filename);
+            function.scope = getString(record.scope);
+            function.storageClass = getString(record.storageClass);
+            function.memberFunctionSpecifier = getString(record.memberFunctionSpecifier);
+            function.fullHeader = getString(record.fullHeader);
+            function.params = getParams(record.params);
+            function.templateParams = getParams(record.templateParams);
+            function.location = getStringList(record.location);
+            function.declarations.reserve(record.declarations.count);
+            for(uint32_t i = record.declarations.start; i < record.declarations.start + record.declarations.count; i++){
+                function.declarations.push_back(getFunction(i));
+            }
+            function.templateSpecializations.reserve(record.templateSpecializations.count);
+            for(uint32_t i = record.templateSpecializations.start; i < record.templateSpecializations.start + record.templateSpecializations.count; i++){
+                function.templateSpecializations.push_back(getFunction(i));
+            }
+            function.isDeclaration = record.isDeclaration;
+            function.isConst = record.isConst;
+            function.isTemplateDecl = record.isTemplateDecl;
+            function.isTemplateSpec = record.isTemplateSpec;
+            return function;
+        }
+    };
+}
@@ -11,36 +11,39 @@ namespace variableanalysis {
         std::vector<VariableInstance> oldVariables;
         std::vector<VariableInstance> newVariables;
         std::vector<VariableInstance> unmatchedOldVariables;
+        // new variables that were already matched (instead of erasing them, so the indices stay the same)
+        std::vector<char> consumed;
         OutputHandler* outputHandler;
         int counter=0;
-    static int findVariable(const std::vector<VariableInstance>& set, const VariableInstance& variableInstance){
+    static int findVariable(const std::vector<VariableInstance>& set, const VariableInstance& variableInstance, const std::vector<char>& skipped){
         // TODO: check if there are more than one variable with the same name and if yes, use the filename as another identifer
         // prioritylist (name has to be the same): qualifiedName > filename > closest match on location
-        std::map<int, VariableInstance> priorityMatches;
-        std::map<int, VariableInstance> secondaryMatches;
+        std::vector<int> priorityMatches;
+        std::vector<int> secondaryMatches;
 
         for(int i=0;i<set.size();i++){
+            if(skipped.at(i)) continue;
             if(set.at(i).qualifiedName == variableInstance.qualifiedName){
-                priorityMatches.insert(std::make_pair(i, set.at(i)));
+                priorityMatches.push_back(i);
                 if(set.at(i).equals(variableInstance)){
                     return i;
                 }
             }else if(set.at(i).name == variableInstance.name){
-                secondaryMatches.insert(std::make_pair(i, set.at(i)));
+                secondaryMatches.push_back(i);
             }
         }
         for(const auto& possibleMatch: priorityMatches){
             // return the first match with the same filename
-            if(possibleMatch.second.filename == variableInstance.filename){
-                return possibleMatch.first;
+            if(set.at(possibleMatch).filename == variableInstance.filename){
+                return possibleMatch;
             }
         }
         // TODO: now filechanges cant be recognized, but i dont have an idea how to do that because trying to include it had the effect of including way to many variables with the same name in different files
 
         for(const auto& possibleMatch: secondaryMatches){
             // return the first match with the same filename
-            if(possibleMatch.second.filename == variableInstance.filename){
-                return possibleMatch.first;
+            if(set.at(possibleMatch).filename == variableInstance.filename){
+                return possibleMatch;
             }
         }
 
@@ -53,14 +56,15 @@ namespace variableanalysis {
             this->outputHandler = outputHandler;
         }
         void compareVariables(){
+            consumed.assign(newVariables.size(), false);
             for (const auto &oldVar: oldVariables){
                 if(oldVar.accessSpecifier == "private" || oldVar.accessSpecifier == "protected"){
                     continue;
                 }
 
-                auto indexInNew = findVariable(newVariables, oldVar);
+                auto indexInNew = findVariable(newVariables, oldVar, consumed);
                 if(indexInNew != -1){
-                    VariableInstance newVar = newVariables.at(indexInNew);
+                    const VariableInstance& newVar = newVariables.at(indexInNew);
                     if(compareLocation(oldVar, newVar, true)){
                         unmatchedOldVariables.push_back(oldVar);
                         continue;
@@ -69,7 +73,7 @@ namespace variableanalysis {
                     compareMainHeader(oldVar, newVar);
                     compareLocation(oldVar, newVar, false);
                     compareQualifiers(oldVar, newVar);
-                    newVariables.erase(newVariables.begin() + indexInNew);
+                    consumed.at(indexInNew) = true;
                 }else{
                     outputHandler->initialiseVariableInstance(oldVar);
                     outputHandler->outputVariableDeleted(oldVar);
@@ -79,14 +83,14 @@ namespace variableanalysis {
             }
 
             for (const auto &oldVar: unmatchedOldVariables){
-                auto indexInNew = findVariable(newVariables, oldVar);
+                auto indexInNew = findVariable(newVariables, oldVar, consumed);
                 if(indexInNew != -1){
-                    VariableInstance newVar = newVariables.at(indexInNew);
+                    const VariableInstance& newVar = newVariables.at(indexInNew);
                     outputHandler->initialiseVariableInstance(oldVar);
                     compareMainHeader(oldVar, newVar);
                     compareLocation(oldVar, newVar, false);
                     compareQualifiers(oldVar, newVar);
-                    newVariables.erase(newVariables.begin() + indexInNew);
+                    consumed.at(indexInNew) = true;
                 }else{
                     outputHandler->initialiseVariableInstance(oldVar);
                     outputHandler->outputVariableDeleted(oldVar);
@@ -1,6 +1,12 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <climits>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <mutex>
 #include "FunctionAnalyser.h"
 
 namespace matcher{
@@ -40,7 +46,75 @@ namespace matcher{
         }
     };
 
-    double compareFunctionBodies(const functionanalysis::FunctionInstance& oldFunc, const functionanalysis::FunctionInstance& newFunc);
-    std::vector<Operation> getOptimalParamConversion(std::vector<std::pair<std::string, std::pair<std::string, std::string>>> oldParamStructure, std::vector<std::pair<std::string, std::pair<std::string, std::string>>> newParamStructure);
+    /*
+     * Ids of the tokens of function bodies, shared by both versions so the same token always has the same id
+     * Bodies of both versions may be tokenized at the same time
+     */
+    class TokenTable {
+    public:
+        // the tokens of a whole body at once, so the lock is only taken once per body
+        std::vector<uint32_t> getIds(const std::vector<std::string_view>& tokens){
+            std::vector<uint32_t> output;
+            output.reserve(tokens.size());
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto &token: tokens){
+                output.push_back(ids.emplace(std::string(token), ids.size()).first->second);
+            }
+            return output;
+        }
+
+    private:
+        std::mutex mutex;
+        std::unordered_map<std::string, uint32_t> ids;
+    };
+
+    /*
+     * Locality-sensitive index over the bodies of functions, used to find the candidates for renamed functions without comparing every pair of bodies
+     * Each body gets a MinHash signature of the shingles (three consecutive tokens) of its code, the signatures are split into bands and bodies that share a band are candidates
+     */
+    class BodyIndex {
+    public:
+        // the ids of the functions are their positions in the vector, declarations are not indexed
+        explicit BodyIndex(const std::vector<functionanalysis::FunctionInstance>& functions);
+        // the ids of at most count bodies with the highest estimated similarity to the body of the function (sorted by their id)
+        std::vector<int> findCandidates(const functionanalysis::FunctionInstance& function, int count) const;
+        // the function is never returned again
+        void remove(int id);
+
+    private:
+        static constexpr int bands = 20;
+        static constexpr int rowsPerBand = 3;
+        static constexpr int signatureLength = bands * rowsPerBand;
+
+        // signatureLength values per id
+        std::vector<uint64_t> signatures;
+        std::vector<char> indexed;
+        // band -> hash of the rows of the band -> ids
+        std::vector<std::unordered_map<uint64_t, std::vector<int>>> buckets;
+
+        static std::vector<uint64_t> computeSignature(const std::string& body);
+        static uint64_t getBandKey(const uint64_t* signature, int band);
+    };
+
+    // the kernels that compute the length of the common beginning (prefix, from the start of the strings) or end (suffix, from behind the ends of the strings) of two strings
+    struct CommonLengthKernels {
+        const char* name;
+        size_t (*prefix)(const char* s1, const char* s2, size_t length);
+        size_t (*suffix)(const char* s1End, const char* s2End, size_t length);
+    };
+
+    // the kernels the processor supports, the fastest first and the scalar ones last (the first one is used)
+    std::vector<CommonLengthKernels> getSupportedCommonLengthKernels();
+
+    double compareFunctionBodies(const functionanalysis::FunctionInstance& oldFunc, const functionanalysis::FunctionInstance& newFunc, double minimumSimilarity = 0);
+    double compareStrippedBodies(std::string_view strippedOldCode, std::string_view strippedNewCode, double minimumSimilarity = 0);
+    // the tokens of a body (views into it), comments and the formatting are dropped
+    std::vector<std::string_view> tokenizeBody(const std::string& body);
+    double compareFunctionBodyTokens(const functionanalysis::FunctionInstance& oldFunc, const functionanalysis::FunctionInstance& newFunc, double minimumSimilarity = 0);
+    // the same as paramsToFlatString(params1) != paramsToFlatString(params2) (i.e. getOptimalParamConversion finds operations), but without allocating
+    bool paramsDiffer(const std::vector<std::pair<std::string, std::pair<std::string, std::string>>>& params1, const std::vector<std::pair<std::string, std::pair<std::string, std::string>>>& params2);
+    std::vector<Operation> getOptimalParamConversion(const std::vector<std::pair<std::string, std::pair<std::string, std::string>>>& oldParamStructure, const std::vector<std::pair<std::string, std::pair<std::string, std::string>>>& newParamStructure);
     std::vector<std::vector<int>> levenshteinDistance(const std::vector<std::string>& s1, const std::vector<std::string>& s2);
+    int levenshteinDistance(std::string_view s1, std::string_view s2, int maxDistance = INT_MAX);
+    int levenshteinDistance(const std::vector<uint32_t>& tokens1, const std::vector<uint32_t>& tokens2, int maxDistance = INT_MAX);
 }
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "FunctionAnalyser.h"
+#include "VariableAnalyser.h"
+#include "ObjectAnalyser.h"
+#include "FilePosition.h"
+
+namespace extraction {
+
+    // the instances are only created by the visitor if the receiving side actually needs them (creating them is the expensive part of the extraction)
+    typedef std::function<functionanalysis::FunctionInstance()> FunctionFactory;
+    typedef std::function<variableanalysis::VariableInstance()> VariableFactory;
+    typedef std::function<objectanalysis::ObjectInstance()> ObjectFactory;
+
+    /*
+     * Receives everything the APIAnalysisVisitor finds in the project files of a translation unit
+     * (either the state of the whole project or a buffer for a single translation unit, which is merged into the state later on)
+     */
+    class ExtractionSink {
+    public:
+        ExtractionSink() = default;
+
+        virtual ~ExtractionSink() = default;
+
+        // a function definition
+        virtual void addFunctionDefinition(const FilePosition& position, const FunctionFactory& create) = 0;
+
+        // a function declaration that has no definition in the current translation unit
+        virtual void addFunctionDeclaration(const FilePosition& position, const FunctionFactory& create) = 0;
+
+        // a function declaration whose definition is known in the current translation unit (definitionFilenameEmpty marks definitions without a resolvable file e.g. from macro expansions)
+        virtual void addDefinedFunctionDeclaration(const FilePosition& position, const FunctionFactory& create, const FilePosition& definitionPosition, bool definitionFilenameEmpty, const FunctionFactory& createDefinition) = 0;
+
+        virtual void addVariable(const FilePosition& position, const VariableFactory& create) = 0;
+
+        virtual void addObject(const FilePosition& position, const ObjectFactory& create) = 0;
+    };
+
+    /*
+     * Collects the findings of a single translation unit, so that translation units can be extracted in parallel
+     * The findings are kept in the order the visitor encountered them and are later replayed into the ExtractionState of the project
+     */
+    class TranslationUnitBuffer : public ExtractionSink {
+    public:
+        struct FunctionRecord {
+            enum Kinds { DEFINITION, DECLARATION, DEFINED_DECLARATION };
+            Kinds kind;
+            // indices into the functions of the buffer
+            int instance;
+            int definition = -1;
+            FilePosition definitionPosition;
+            bool definitionFilenameEmpty = false;
+        };
+
+        std::vector<functionanalysis::FunctionInstance> functions;
+        std::vector<FunctionRecord> functionRecords;
+        std::vector<variableanalysis::VariableInstance> variables;
+        std::vector<objectanalysis::ObjectInstance> objects;
+
+        void addFunctionDefinition(const FilePosition& position, const FunctionFactory& create) override {
+            FunctionRecord record;
+            record.kind = FunctionRecord::DEFINITION;
+            record.instance = getDefinition(position, create);
+            functionRecords.push_back(record);
+        }
+
+        void addFunctionDeclaration(const FilePosition& position, const FunctionFactory& create) override {
+            FunctionRecord record;
+            record.kind = FunctionRecord::DECLARATION;
+            record.instance = getDeclaration(position, create);
+            functionRecords.push_back(record);
+        }
+
+        void addDefinedFunctionDeclaration(const FilePosition& position, const FunctionFactory& create, const FilePosition& definitionPosition, bool definitionFilenameEmpty, const FunctionFactory& createDefinition) override {
+            FunctionRecord record;
+            record.kind = FunctionRecord::DEFINED_DECLARATION;
+            record.instance = getDeclaration(position, create);
+            record.definition = getDefinition(definitionPosition, createDefinition);
+            record.definitionPosition = definitionPosition;
+            record.definitionFilenameEmpty = definitionFilenameEmpty;
+            functionRecords.push_back(record);
+        }
+
+        void addVariable(const FilePosition& position, const VariableFactory& create) override {
+            // a variable that was already found in this translation unit would be ignored by the ExtractionState anyway
+            if(foundVariables.insert(std::make_pair(position, variables.size())).second){
+                variables.push_back(create());
+            }
+        }
+
+        void addObject(const FilePosition& position, const ObjectFactory& create) override {
+            if(foundObjects.insert(std::make_pair(position, objects.size())).second){
+                objects.push_back(create());
+            }
+        }
+
+    private:
+        // the buffer does not know the state of the project, so every instance has to be created, but only once per translation unit
+        std::unordered_map<FilePosition, int, FilePositionHash> createdDefinitions;
+        std::unordered_map<FilePosition, int, FilePositionHash> createdDeclarations;
+        std::unordered_map<FilePosition, size_t, FilePositionHash> foundVariables;
+        std::unordered_map<FilePosition, size_t, FilePositionHash> foundObjects;
+
+        int getDefinition(const FilePosition& position, const FunctionFactory& create){
+            auto found = createdDefinitions.find(position);
+            if(found != createdDefinitions.end()){
+                return found->second;
+            }
+            functions.push_back(create());
+            createdDefinitions.insert(std::make_pair(position, functions.size() - 1));
+            return functions.size() - 1;
+        }
+
+        int getDeclaration(const FilePosition& position, const FunctionFactory& create){
+            auto found = createdDeclarations.find(position);
+            if(found != createdDeclarations.end()){
+                return found->second;
+            }
+            functions.push_back(create());
+            createdDeclarations.insert(std::make_pair(position, functions.size() - 1));
+            return functions.size() - 1;
+        }
+    };
+}
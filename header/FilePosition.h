@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+namespace extraction {
+
+    /*
+     * The position of an extracted declaration (file, line and column of its beginning)
+     * The file is stored as an id of the FileTable of the version, so positions can be compared and hashed without any string work
+     */
+    struct FilePosition {
+        int file = -1;
+        unsigned line = 0;
+        unsigned column = 0;
+        // definitions without a filename (see ExtractionState) are stored at the file of their declaration, this keeps them apart from the real positions in that file
+        bool unresolved = false;
+
+        bool operator==(const FilePosition& other) const {
+            return file == other.file && line == other.line && column == other.column && unresolved == other.unresolved;
+        }
+
+        bool operator!=(const FilePosition& other) const {
+            return !(*this == other);
+        }
+    };
+
+    struct FilePositionHash {
+        size_t operator()(const FilePosition& position) const {
+            size_t hash = std::hash<int>()(position.file);
+            hash = hash * 31 + std::hash<unsigned>()(position.line);
+            hash = hash * 31 + std::hash<unsigned>()(position.column);
+            return hash * 2 + position.unresolved;
+        }
+    };
+
+    /*
+     * Maps the (relative) filenames of a version to ids and back
+     * The table is shared by all translation units of a version, which may be extracted in parallel
+     */
+    class FileTable {
+    public:
+        int getId(const std::string& filename){
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = ids.find(filename);
+            if(found != ids.end()){
+                return found->second;
+            }
+            filenames.push_back(filename);
+            ids.insert(std::make_pair(filename, filenames.size() - 1));
+            return filenames.size() - 1;
+        }
+
+        std::string getFilename(int id) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return filenames.at(id);
+        }
+
+        // the textual form of a position ("filename:line:column")
+        std::string format(const FilePosition& position) const {
+            return getFilename(position.file) + (position.unresolved ? "{err}" : "") + ":" + std::to_string(position.line) + ":" + std::to_string(position.column);
+        }
+
+    private:
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, int> ids;
+        std::vector<std::string> filenames;
+    };
+}
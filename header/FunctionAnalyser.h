@@ -3,8 +3,10 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <cstdint>
 #include <clang/AST/RecursiveASTVisitor.h>
 #include "../include/json.hpp"
+#include "FilePosition.h"
 
 namespace functionanalysis{
     class FunctionInstance {
@@ -16,8 +18,12 @@ namespace functionanalysis{
         // [type, [name, default value]]
         std::vector<std::pair<std::string, std::pair<std::string, std::string>>> params;
         std::string body;
+        // see helper::getNormalizedBodyHash
+        uint64_t bodyHash = 0;
+        // ids of the tokens of the body (see matcher::TokenTable), only set for the token based comparison of bodies
+        std::vector<uint32_t> bodyTokens;
         std::vector<std::string> location;
-        std::string filePosition;
+        extraction::FilePosition filePosition;
         std::vector<FunctionInstance> declarations;
         std::string filename;
         std::string scope;
@@ -79,7 +85,7 @@ namespace functionanalysis{
                     storageClass == decl.storageClass && memberFunctionSpecifier == decl.memberFunctionSpecifier);
         }
 
-        [[nodiscard]] bool equals(FunctionInstance func) const{
+        [[nodiscard]] bool equals(const FunctionInstance& func) const{
             // check if the params match
             if (params.size() == func.params.size()) {
                 for (int i = 0; i < params.size(); ++i) {
@@ -95,5 +101,29 @@ namespace functionanalysis{
                     storageClass == func.storageClass && isDeclaration == func.isDeclaration && memberFunctionSpecifier == func.memberFunctionSpecifier);
         }
 
+        // the copy of the function that is kept in the declarations of a function: only the header and position are read from there, so the body and the nested lists are left out
+        // (every definition has an entry of itself, which would otherwise double the memory of its body)
+        [[nodiscard]] FunctionInstance getDeclarationEntry() const {
+            FunctionInstance entry;
+            entry.isDeclaration = isDeclaration;
+            entry.name = name;
+            entry.qualifiedName = qualifiedName;
+            entry.returnType = returnType;
+            entry.params = params;
+            entry.bodyHash = bodyHash;
+            entry.location = location;
+            entry.filePosition = filePosition;
+            entry.filename = filename;
+            entry.scope = scope;
+            entry.storageClass = storageClass;
+            entry.memberFunctionSpecifier = memberFunctionSpecifier;
+            entry.fullHeader = fullHeader;
+            entry.isConst = isConst;
+            entry.isTemplateDecl = isTemplateDecl;
+            entry.isTemplateSpec = isTemplateSpec;
+            entry.templateParams = templateParams;
+            return entry;
+        }
+
     };
 }
\ No newline at end of file
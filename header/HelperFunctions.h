@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include "FunctionAnalyser.h"
 
 namespace helper {
@@ -8,11 +9,14 @@ namespace helper {
     std::string getAllNamespacesAsString(const std::vector<std::string>& params);
     std::string stripCodeOfEmptySpaces(std::string code);
     std::string stripCodeOfComments(std::string code);
+    uint64_t getNormalizedBodyHash(const std::string& body);
     std::vector<std::string> convertPairIntoFlatVector(const std::vector<std::pair<std::string, std::pair<std::string, std::string>>>& vec);
     std::string retrieveFunctionHeader(const functionanalysis::FunctionInstance& func);
     std::string getAllTemplateParamsAsString(const std::vector<std::pair<std::string, std::pair<std::string, std::string>>>& templateParams);
     std::string getSingleTemplateParamAsString(const std::pair<std::string, std::pair<std::string, std::string>>& templateParam);
     bool paramsAreEqual(const std::vector<std::pair<std::string, std::pair<std::string, std::string>>>& param1, const std::vector<std::pair<std::string, std::pair<std::string, std::string>>>& param2);
     std::vector<std::string> excludeFiles(const std::string &path, std::vector<std::string> listOfFiles, const std::vector<std::string>* excludedFiles);
-    std::pair<std::vector<std::string>, std::vector<std::string>> filterUnchangedFiles(const std::vector<std::string>& oldFiles, const std::vector<std::string>& newFiles, std::string oldPath, std::string newPath);
+    std::pair<std::vector<std::string>, std::vector<std::string>> filterUnchangedFiles(const std::vector<std::string>& oldFiles, const std::vector<std::string>& newFiles, std::string oldPath, std::string newPath, const std::function<bool(const std::string&, const std::string&)>& includesUnchanged = nullptr, int jobs = 1);
+    bool filesAreEqual(const std::string& oldFile, const std::string& newFile);
+    bool hashFile(const std::string& path, uint64_t* hash);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <clang/Frontend/FrontendActions.h>
+#include "FilePosition.h"
 
 namespace objectanalysis{
     class ObjectInstance{
@@ -12,7 +13,7 @@ namespace objectanalysis{
         std::string qualifiedName;
         std::vector<std::string> location;
         std::string filename;
-        std::string filePosition;
+        extraction::FilePosition filePosition;
         bool isAbstract;
         bool isFinal;
     };
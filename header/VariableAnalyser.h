@@ -2,6 +2,7 @@
 
 #include <string>
 #include <vector>
+#include "FilePosition.h"
 
 namespace variableanalysis{
 
@@ -13,7 +14,7 @@ namespace variableanalysis{
         std::string type;
         std::vector<std::string> location;
         std::string filename;
-        std::string filePosition;
+        extraction::FilePosition filePosition;
         std::string storageClass;
         bool isInline;
         std::string accessSpecifier;
@@ -0,0 +1,148 @@
+/*
+ * Checks that the comparisons of the matching loop do not allocate once their buffers have grown (they run for every pair of candidates)
+ * The global operator new is replaced to count the allocations, the first call of every comparison is allowed to allocate
+ * The rename search of the FunctionAnalyser is checked as a whole: its allocations may grow with the number of old and of new functions, but not with their product
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "../FunctionAnalyser.cpp"
+#include "../ConsoleOutputHandler.cpp"
+
+static long allocations = 0;
+
+void* operator new(std::size_t size){
+    allocations++;
+    void* pointer = std::malloc(size == 0 ? 1 : size);
+    if(!pointer){
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+// a template with two params and two specializations, the body is different for every seed
+FunctionInstance createFunction(const std::string& name, int seed){
+    FunctionInstance func;
+    func.isDeclaration = false;
+    func.name = name;
+    func.qualifiedName = "test::" + name;
+    func.returnType = "int";
+    func.params = {{"int", {"a", ""}}, {"double", {"b", "0"}}};
+    func.body = "{ int x = a;";
+    for(int i = 0; i < 20; i++){
+        func.body += " x = x * " + std::to_string(seed * 31 + i) + " + (int) b;";
+    }
+    func.body += " return x; }";
+    func.bodyHash = helper::getNormalizedBodyHash(func.body);
+    func.location = {"test"};
+    func.filename = "test.cpp";
+    func.scope = "public";
+    func.isConst = false;
+    func.isTemplateDecl = true;
+    func.isTemplateSpec = false;
+    func.templateParams = {{"typename", {"T", ""}}};
+    for(const auto &type: {"char", "long"}){
+        FunctionInstance specialization = func;
+        specialization.isTemplateDecl = false;
+        specialization.isTemplateSpec = true;
+        specialization.params.at(0).first = type;
+        func.templateSpecializations.push_back(specialization);
+    }
+    return func;
+}
+
+// every old function is renamed in the new version, the other new functions have a different header and are never matched
+long countRenameSearch(int oldFunctions, int otherFunctions){
+    std::vector<FunctionInstance> oldProgram, newProgram;
+    for(int i = 0; i < oldFunctions; i++){
+        oldProgram.push_back(createFunction("old" + std::to_string(i), i));
+        newProgram.push_back(createFunction("renamed" + std::to_string(i), i));
+    }
+    for(int i = 0; i < otherFunctions; i++){
+        FunctionInstance other = createFunction("other" + std::to_string(i), 1000 + i);
+        if(i % 3 == 0){
+            // a param more
+            other.params.push_back({"bool", {"c", ""}});
+        }else if(i % 3 == 1){
+            // a param less at the beginning
+            other.params.erase(other.params.begin());
+        }else{
+            // the same params, but other template params and specializations
+            other.templateParams = {{"class", {"U", ""}}, {"int", {"N", "1"}}};
+            other.templateSpecializations.at(1).params.at(1).second.second = "1";
+        }
+        newProgram.push_back(other);
+    }
+    ConsoleOutputHandler outputHandler;
+    FunctionAnalyser analyser(std::move(oldProgram), std::move(newProgram), &outputHandler);
+    long before = allocations;
+    analyser.compareVersionsWithDoc(true, true);
+    return allocations - before;
+}
+
+int main(){
+    int failures = 0;
+
+    std::string oldBody(3000, 'a');
+    for(int i = 0; i < oldBody.size(); i++){
+        oldBody[i] = 'a' + i % 26;
+    }
+    std::string newBody = oldBody;
+    newBody[100] = '#';
+    newBody.insert(2000, "abc");
+
+    std::vector<uint32_t> oldTokens(800);
+    for(int i = 0; i < oldTokens.size(); i++){
+        oldTokens[i] = i % 97;
+    }
+    std::vector<uint32_t> newTokens = oldTokens;
+    newTokens[5] = 1000;
+
+    std::vector<std::pair<std::string, std::pair<std::string, std::string>>> params{{"int", {"x", ""}}, {"char", {"y", "1"}}};
+    std::vector<std::pair<std::string, std::pair<std::string, std::string>>> otherParams{{"int", {"x", ""}}, {"char", {"y", "2"}}, {"bool", {"z", ""}}};
+    std::vector<std::pair<std::string, std::pair<std::string, std::string>>> templateParams{{"typename", {"T", ""}}};
+    std::vector<std::pair<std::string, std::pair<std::string, std::string>>> otherTemplateParams{{"class", {"U", ""}}, {"int", {"N", "1"}}};
+
+    // the buffers grow in the first call
+    double sum = matcher::compareStrippedBodies(oldBody, newBody, 90);
+    sum += matcher::levenshteinDistance(oldTokens, newTokens, 100);
+
+    long before = allocations;
+    for(int i = 0; i < 1000; i++){
+        sum += matcher::compareStrippedBodies(oldBody, newBody, 90);
+        sum += matcher::levenshteinDistance(oldTokens, newTokens, 100);
+        sum += matcher::paramsDiffer(params, otherParams);
+        sum += matcher::paramsDiffer(otherParams, params);
+        sum += matcher::paramsDiffer(params, params);
+        sum += matcher::paramsDiffer(templateParams, otherTemplateParams);
+    }
+    long counted = allocations - before;
+    std::printf("%ld allocations of the comparisons in 1000 iterations (%f)\n", counted, sum);
+    if(counted != 0){
+        failures++;
+    }
+
+    // the largest search first, so that the buffers of the search have grown
+    const int oldFunctions = 20, fewOthers = 20, manyOthers = 80;
+    countRenameSearch(oldFunctions, manyOthers);
+    // the allocations for the other functions alone (indices, stripped bodies, ...) are subtracted
+    long withOld = countRenameSearch(oldFunctions, manyOthers) - countRenameSearch(oldFunctions, fewOthers);
+    long withoutOld = countRenameSearch(0, manyOthers) - countRenameSearch(0, fewOthers);
+    long perPair = withOld - withoutOld;
+    std::printf("%ld allocations of the rename search for %d old and %d more new functions\n", perPair, oldFunctions, manyOthers - fewOthers);
+    // less than one allocation per old function, an allocation in the comparison of a pair would add one for every pair
+    if(perPair >= oldFunctions){
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
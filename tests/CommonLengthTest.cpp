@@ -0,0 +1,44 @@
+/*
+ * Compares every common prefix / suffix kernel the processor supports with the scalar one on random strings
+ * The strings differ at random positions (or not at all) and start at every alignment, so the tails and the unaligned loads of the vector kernels are covered
+ */
+#include <random>
+#include <string>
+#include <cstdio>
+#include "../header/CodeMatcher.h"
+
+int main(){
+    auto kernels = matcher::getSupportedCommonLengthKernels();
+    const auto& scalar = kernels.back();
+    std::mt19937 random(7);
+    int failures = 0;
+    for (const auto &kernel: kernels){
+        std::printf("testing the %s kernels\n", kernel.name);
+        for(int test = 0; test < 20000; test++){
+            size_t length = random() % (test % 10 == 0 ? 1000 : 150);
+            std::string s1(length + 64, 'a');
+            for(auto &c: s1){
+                c = "ab"[random() % 2];
+            }
+            std::string s2 = s1;
+            // the shift of the second string moves it to another alignment than the first
+            size_t offset1 = random() % 64, offset2 = random() % 64;
+            s2 = std::string(offset2, 'x') + s2.substr(offset1);
+            s2.resize(offset2 + length + 64, 'a');
+            // no difference, a single one or some of them
+            int differences = random() % 4;
+            for(int i = 0; i < differences && length > 0; i++){
+                s2[offset2 + random() % length] ^= 1;
+            }
+            const char* begin1 = s1.data() + offset1;
+            const char* begin2 = s2.data() + offset2;
+            size_t prefix = kernel.prefix(begin1, begin2, length);
+            size_t suffix = kernel.suffix(begin1 + length, begin2 + length, length);
+            if(prefix != scalar.prefix(begin1, begin2, length) || suffix != scalar.suffix(begin1 + length, begin2 + length, length)){
+                std::printf("the %s kernels differ for a length of %zu\n", kernel.name, length);
+                failures++;
+            }
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
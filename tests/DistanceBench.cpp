@@ -0,0 +1,62 @@
+/*
+ * Compares the bit-parallel distance of function bodies (matcher::levenshteinDistance) with the two-row dynamic programming it replaced
+ * Bodies of different lengths are generated with about 5% of their characters changed, as it is the case for renamed functions
+ */
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include "../header/CodeMatcher.h"
+
+int twoRowDistance(const std::string& s1, const std::string& s2){
+    std::vector<int> previous(s2.size() + 1), current(s2.size() + 1);
+    for(size_t j = 0; j <= s2.size(); j++){
+        previous[j] = j;
+    }
+    for(size_t i = 1; i <= s1.size(); i++){
+        current[0] = i;
+        for(size_t j = 1; j <= s2.size(); j++){
+            current[j] = std::min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + (s1[i - 1] == s2[j - 1] ? 0 : 1)});
+        }
+        std::swap(previous, current);
+    }
+    return previous[s2.size()];
+}
+
+template<typename Function>
+double measure(int repetitions, const Function& function){
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < repetitions; i++){
+        function();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repetitions;
+}
+
+int main(){
+    std::mt19937 random(42);
+    const std::string alphabet = "abcdefghijklmnopqrstuvwxyz(){};=+-*<>,.0123456789";
+    std::printf("%8s %12s %12s %12s %8s\n", "length", "two rows", "bit-parallel", "cutoff 90%", "speedup");
+    for(int length : {256, 1024, 4096, 16384}){
+        std::string s1;
+        for(int i = 0; i < length; i++){
+            s1 += alphabet[random() % alphabet.size()];
+        }
+        std::string s2 = s1;
+        for(int i = 0; i < length / 20; i++){
+            s2[random() % s2.size()] = alphabet[random() % alphabet.size()];
+        }
+        int expected = twoRowDistance(s1, s2);
+        if(matcher::levenshteinDistance(s1, s2) != expected){
+            std::printf("the distances differ for length %d\n", length);
+            return 1;
+        }
+        int repetitions = std::max(1, 4000000 / length / length * 16);
+        double twoRows = measure(std::max(1, repetitions / 16), [&](){ return twoRowDistance(s1, s2); });
+        double bitParallel = measure(repetitions, [&](){ return matcher::levenshteinDistance(s1, s2); });
+        double cutoff = measure(repetitions, [&](){ return matcher::levenshteinDistance(s1, s2, length / 10 + 1); });
+        std::printf("%8d %10.3fms %10.3fms %10.3fms %7.0fx\n", length, twoRows, bitParallel, cutoff, twoRows / bitParallel);
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * Checks that comments inside bodies are dropped by matcher::tokenizeBody, including line comments that start like block comments (//***)
+ */
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "../header/CodeMatcher.h"
+
+bool expectTokens(const std::string& body, const std::vector<std::string>& expected){
+    std::vector<std::string> tokens;
+    for (const auto &token: matcher::tokenizeBody(body)){
+        tokens.emplace_back(token);
+    }
+    if(tokens != expected){
+        std::printf("unexpected tokens for: %s\n", body.c_str());
+        for (const auto &token: tokens){
+            std::printf("  %s\n", token.c_str());
+        }
+        return false;
+    }
+    return true;
+}
+
+int main(){
+    const std::vector<std::string> expected{"{", "int", "a", "=", "1", ";", "return", "a", ";", "}"};
+    bool passed = true;
+    passed &= expectTokens("{ int a = 1; return a; }", expected);
+    passed &= expectTokens("{\n    int a = 1;\n    //*********************\n    return a;\n}", expected);
+    passed &= expectTokens("{\n    int a = 1; //* banner\n    return a; // end\n}", expected);
+    passed &= expectTokens("{\n    int a = /* one */ 1;\n    return a;\n}", expected);
+    return passed ? 0 : 1;
+}